@@ -0,0 +1,183 @@
+/* Copyright (c) 2013 John Brooks <john.brooks@dereferenced.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "aspectcache_p.h"
+#include <QSaveFile>
+#include <QVector>
+#include <QDebug>
+#include <algorithm>
+#include <cstring>
+
+static const char cacheMagic[4] = { 'F', 'G', 'A', 'C' };
+static const quint32 cacheVersion = 1;
+
+AspectCache::AspectCache()
+    : m_map(0)
+    , m_count(0)
+    , m_keys(0)
+    , m_aspects(0)
+{
+}
+
+AspectCache::~AspectCache()
+{
+    unmap();
+}
+
+void AspectCache::setFileName(const QString &fileName)
+{
+    if (m_fileName == fileName)
+        return;
+
+    unmap();
+    m_pending.clear();
+    m_fileName = fileName;
+    if (!m_fileName.isEmpty())
+        map();
+}
+
+bool AspectCache::map()
+{
+    m_file.setFileName(m_fileName);
+    if (!m_file.exists() || !m_file.open(QIODevice::ReadOnly))
+        return false;
+
+    qint64 size = m_file.size();
+    uchar *data = size >= qint64(sizeof(Header)) ? m_file.map(0, size) : 0;
+    if (!data) {
+        m_file.close();
+        return false;
+    }
+
+    const Header *header = reinterpret_cast<const Header*>(data);
+    if (memcmp(header->magic, cacheMagic, sizeof(cacheMagic)) || header->version != cacheVersion ||
+        qint64(sizeof(Header)) + qint64(header->count) * (sizeof(quint64) + sizeof(float)) > size)
+    {
+        qWarning() << "FittingGridView: ignoring invalid aspect cache" << m_fileName;
+        m_file.unmap(data);
+        m_file.close();
+        return false;
+    }
+
+    m_map = data;
+    m_count = header->count;
+    m_keys = reinterpret_cast<const quint64*>(data + sizeof(Header));
+    m_aspects = reinterpret_cast<const float*>(m_keys + m_count);
+    return true;
+}
+
+void AspectCache::unmap()
+{
+    if (m_map) {
+        m_file.unmap(m_map);
+        m_map = 0;
+    }
+    m_file.close();
+    m_count = 0;
+    m_keys = 0;
+    m_aspects = 0;
+}
+
+double AspectCache::value(quint64 key) const
+{
+    // New values replace mapped ones before they're saved
+    auto pending = m_pending.constFind(key);
+    if (pending != m_pending.constEnd())
+        return pending.value();
+
+    if (m_count) {
+        const quint64 *it = std::lower_bound(m_keys, m_keys + m_count, key);
+        if (it != m_keys + m_count && *it == key)
+            return m_aspects[it - m_keys];
+    }
+    return -1;
+}
+
+void AspectCache::setValue(quint64 key, double aspect)
+{
+    if (!isEnabled() || aspect <= 0 || float(aspect) == value(key))
+        return;
+    m_pending.insert(key, aspect);
+}
+
+bool AspectCache::save()
+{
+    if (!isEnabled() || m_pending.isEmpty())
+        return true;
+
+    // Merge mapped and new values, with new values replacing any old ones
+    QVector<QPair<quint64,float>> entries;
+    entries.reserve(m_count + m_pending.size());
+    for (int i = 0; i < m_count; i++) {
+        if (!m_pending.contains(m_keys[i]))
+            entries.append(qMakePair(m_keys[i], m_aspects[i]));
+    }
+    for (auto it = m_pending.constBegin(); it != m_pending.constEnd(); it++)
+        entries.append(qMakePair(it.key(), it.value()));
+    std::sort(entries.begin(), entries.end());
+
+    // The old file can't be replaced while it's mapped on all platforms
+    unmap();
+
+    QSaveFile file(m_fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "FittingGridView: cannot write aspect cache" << m_fileName << file.errorString();
+        map();
+        return false;
+    }
+
+    Header header;
+    memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+    header.version = cacheVersion;
+    header.count = entries.size();
+    header.reserved = 0;
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    QVector<quint64> keys(entries.size());
+    QVector<float> aspects(entries.size());
+    for (int i = 0; i < entries.size(); i++) {
+        keys[i] = entries[i].first;
+        aspects[i] = entries[i].second;
+    }
+    file.write(reinterpret_cast<const char*>(keys.constData()), keys.size() * sizeof(quint64));
+    file.write(reinterpret_cast<const char*>(aspects.constData()), aspects.size() * sizeof(float));
+
+    if (!file.commit()) {
+        qWarning() << "FittingGridView: cannot write aspect cache" << m_fileName << file.errorString();
+        map();
+        return false;
+    }
+
+    m_pending.clear();
+    map();
+    return true;
+}
+
+quint64 AspectCache::key(const QString &id)
+{
+    // 64-bit FNV-1a, which unlike qHash is stable between runs
+    quint64 hash = Q_UINT64_C(14695981039346656037);
+    const ushort *c = id.utf16();
+    for (int i = 0; i < id.size(); i++) {
+        hash ^= c[i];
+        hash *= Q_UINT64_C(1099511628211);
+    }
+    return hash;
+}
@@ -0,0 +1,79 @@
+/* Copyright (c) 2013 John Brooks <john.brooks@dereferenced.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef ASPECTCACHE_P_H
+#define ASPECTCACHE_P_H
+
+#include <QFile>
+#include <QHash>
+#include <QString>
+
+/* Persistent aspect ratios of model items, keyed by a hash of a stable id.
+ *
+ * The file is a header followed by a sorted array of 64-bit keys and a parallel
+ * array of float aspect ratios, in native byte order. It's memory mapped read-only,
+ * and lookups are a binary search over the keys, so opening even a very large
+ * cache is immediate. New values are kept in memory and merged into the file by
+ * save().
+ */
+class AspectCache
+{
+public:
+    AspectCache();
+    ~AspectCache();
+
+    QString fileName() const { return m_fileName; }
+    bool isEnabled() const { return !m_fileName.isEmpty(); }
+    bool isDirty() const { return !m_pending.isEmpty(); }
+    // Number of values in the mapped file
+    int count() const { return m_count; }
+
+    // Maps fileName if it exists; values are saved to fileName even if it doesn't.
+    void setFileName(const QString &fileName);
+
+    // Returns a negative value for unknown keys
+    double value(quint64 key) const;
+    void setValue(quint64 key, double aspect);
+
+    bool save();
+
+    static quint64 key(const QString &id);
+
+private:
+    struct Header {
+        char magic[4];
+        quint32 version;
+        quint32 count;
+        quint32 reserved;
+    };
+
+    QString m_fileName;
+    QFile m_file;
+    uchar *m_map;
+    int m_count;
+    const quint64 *m_keys;
+    const float *m_aspects;
+    QHash<quint64,float> m_pending;
+
+    bool map();
+    void unmap();
+};
+
+#endif // ASPECTCACHE_P_H
@@ -0,0 +1,151 @@
+/* Copyright (c) 2013 John Brooks <john.brooks@dereferenced.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "aspectstore_p.h"
+#include <algorithm>
+#include <cstring>
+
+constexpr double AspectStore::Unknown;
+
+AspectStore::AspectStore()
+    : m_gapStart(0)
+    , m_gapEnd(0)
+    , m_revision(0)
+    , m_knownCount(0)
+    , m_knownSum(0)
+{
+}
+
+void AspectStore::setValue(int index, double value)
+{
+    Q_ASSERT(index >= 0);
+
+    int oldSize = size();
+    if (index >= oldSize) {
+        if (value == Unknown)
+            return;
+        // Grow by filling the gap at the end with unknown values
+        int count = index + 1 - oldSize;
+        moveGap(oldSize);
+        reserveGap(count);
+        std::fill(m_data.begin() + m_gapStart, m_data.begin() + m_gapStart + count, Unknown);
+        m_gapStart += count;
+    }
+
+    double &v = m_data[index < m_gapStart ? index : index + gapSize()];
+    if (v != value) {
+        if (v > 0) {
+            m_knownCount--;
+            m_knownSum -= v;
+        }
+        if (value > 0) {
+            m_knownCount++;
+            m_knownSum += value;
+        }
+        v = value;
+        m_revision++;
+    }
+}
+
+void AspectStore::insertRange(int index, int count)
+{
+    // Unknown values past the end don't need to be stored
+    if (index >= size() || count <= 0)
+        return;
+
+    moveGap(index);
+    reserveGap(count);
+    std::fill(m_data.begin() + m_gapStart, m_data.begin() + m_gapStart + count, Unknown);
+    m_gapStart += count;
+    m_revision++;
+}
+
+void AspectStore::removeRange(int index, int count)
+{
+    count = qMin(count, size() - index);
+    if (count <= 0)
+        return;
+
+    moveGap(index);
+    for (int i = m_gapEnd; i < m_gapEnd + count; i++) {
+        if (m_data[i] > 0) {
+            m_knownCount--;
+            m_knownSum -= m_data[i];
+        }
+    }
+    m_gapEnd += count;
+    m_revision++;
+}
+
+void AspectStore::clear()
+{
+    m_data.clear();
+    m_gapStart = m_gapEnd = 0;
+    m_knownCount = 0;
+    m_knownSum = 0;
+    m_revision++;
+}
+
+void AspectStore::appendTo(QVector<double> *values, int index, int count) const
+{
+    int end = index + count;
+    int front = qBound(index, m_gapStart, end);
+    int back = qBound(front, size(), end);
+    for (int i = index; i < front; i++)
+        values->append(m_data[i]);
+    for (int i = front; i < back; i++)
+        values->append(m_data[i + gapSize()]);
+    for (int i = back; i < end; i++)
+        values->append(Unknown);
+}
+
+void AspectStore::moveGap(int index)
+{
+    Q_ASSERT(index >= 0 && index <= size());
+
+    double *data = m_data.data();
+    if (index < m_gapStart) {
+        int count = m_gapStart - index;
+        memmove(data + m_gapEnd - count, data + index, count * sizeof(double));
+        m_gapStart -= count;
+        m_gapEnd -= count;
+    } else if (index > m_gapStart) {
+        int count = index - m_gapStart;
+        memmove(data + m_gapStart, data + m_gapEnd, count * sizeof(double));
+        m_gapStart += count;
+        m_gapEnd += count;
+    }
+}
+
+void AspectStore::reserveGap(int count)
+{
+    if (gapSize() >= count)
+        return;
+
+    // Grow geometrically so that a sequence of inserts or appends is amortized O(1)
+    int tail = m_data.size() - m_gapEnd;
+    int newGap = qMax(count, qMax(size() / 2, 64));
+    QVector<double> data(m_gapStart + newGap + tail);
+    std::copy(m_data.constBegin(), m_data.constBegin() + m_gapStart, data.begin());
+    std::copy(m_data.constBegin() + m_gapEnd, m_data.constEnd(), data.begin() + m_gapStart + newGap);
+
+    m_data.swap(data);
+    m_gapEnd = m_gapStart + newGap;
+}
@@ -0,0 +1,81 @@
+/* Copyright (c) 2013 John Brooks <john.brooks@dereferenced.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef ASPECTSTORE_P_H
+#define ASPECTSTORE_P_H
+
+#include <QVector>
+
+/* Aspect ratios of model items, stored contiguously by index in a gap buffer.
+ *
+ * Lookup is O(1), and inserting or removing a range of indexes only moves the gap to
+ * that position, so repeated changes near the same place (e.g. prepends) are cheap.
+ * Indexes which have never been set, or were invalidated, have an unknown aspect.
+ */
+class AspectStore
+{
+public:
+    static constexpr double Unknown = -1;
+
+    AspectStore();
+
+    int size() const { return m_data.size() - gapSize(); }
+    bool isEmpty() const { return !size(); }
+
+    bool contains(int index) const { return value(index) != Unknown; }
+    double value(int index) const
+    {
+        if (index < 0 || index >= size())
+            return Unknown;
+        return m_data[index < m_gapStart ? index : index + gapSize()];
+    }
+
+    void setValue(int index, double value);
+    void invalidate(int index) { if (index < size()) setValue(index, Unknown); }
+
+    // Shift indexes for count items inserted or removed at index
+    void insertRange(int index, int count);
+    void removeRange(int index, int count);
+
+    void clear();
+
+    // Changes whenever any value or index changes
+    int revision() const { return m_revision; }
+    // Append count values from index to values, with unknown values past the end
+    void appendTo(QVector<double> *values, int index, int count) const;
+
+    // Number and mean of all values that are greater than zero, maintained incrementally
+    int knownCount() const { return m_knownCount; }
+    double knownMean() const { return m_knownCount ? (m_knownSum / m_knownCount) : 0; }
+
+private:
+    QVector<double> m_data;
+    int m_gapStart;
+    int m_gapEnd;
+    int m_revision;
+    int m_knownCount;
+    double m_knownSum;
+
+    int gapSize() const { return m_gapEnd - m_gapStart; }
+    void moveGap(int index);
+    void reserveGap(int count);
+};
+
+#endif // ASPECTSTORE_P_H
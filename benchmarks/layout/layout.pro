@@ -0,0 +1,10 @@
+TEMPLATE = app
+TARGET = tst_bench_layout
+QT += testlib
+CONFIG += console
+CONFIG -= app_bundle
+
+include(../shared/shared.pri)
+
+SOURCES += \
+    tst_bench_layout.cpp
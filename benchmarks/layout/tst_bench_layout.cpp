@@ -0,0 +1,290 @@
+/* Copyright (c) 2013 John Brooks <john.brooks@dereferenced.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "fittinggridview.h"
+#include "aspectmodel.h"
+#include <QtTest>
+#include <QGuiApplication>
+#include <QQmlEngine>
+#include <QQmlComponent>
+#include <QQmlContext>
+#include <QQuickWindow>
+#include <QtQuick/private/qquickwindow_p.h>
+
+/* A view in a window that is never shown. Layouts run by polishing the window's items
+ * directly, which is what updatePolish() does once per frame in a real scene.
+ */
+class ViewFixture
+{
+public:
+    ViewFixture(QQmlEngine *engine, AspectModel *model);
+    ~ViewFixture();
+
+    AspectModel *model;
+    QQuickWindow window;
+    FittingGridView *view;
+
+    void layout();
+    QQuickItem *flickable() const { return view->flickable(); }
+    double contentHeight() const { return flickable()->property("contentHeight").toDouble(); }
+    void scrollTo(double y);
+};
+
+ViewFixture::ViewFixture(QQmlEngine *engine, AspectModel *m)
+    : model(m)
+    , view(0)
+{
+    QQmlContext *context = new QQmlContext(engine->rootContext(), &window);
+    context->setContextProperty("benchmarkModel", model);
+
+    QQmlComponent component(engine);
+    component.setData("import QtQuick 2.0\n"
+                      "import FittingGridView 1.0\n"
+                      "FittingGridView {\n"
+                      "    width: 800; height: 600\n"
+                      "    model: benchmarkModel\n"
+                      "    aspectRatioRole: \"aspectRatio\"\n"
+                      "    delegate: Item {}\n"
+                      "}\n", QUrl());
+    view = qobject_cast<FittingGridView*>(component.create(context));
+    if (!view)
+        qFatal("Cannot create view: %s", qPrintable(component.errorString()));
+    view->setParentItem(window.contentItem());
+    view->polish();
+}
+
+ViewFixture::~ViewFixture()
+{
+    delete view;
+}
+
+void ViewFixture::layout()
+{
+    QQuickWindowPrivate::get(&window)->polishItems();
+}
+
+void ViewFixture::scrollTo(double y)
+{
+    flickable()->setProperty("contentY", qBound(0.0, y, qMax(contentHeight() - view->height(), 0.0)));
+}
+
+class LayoutBenchmark : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void coldLayout_data() { addModels(); }
+    void coldLayout();
+    void scrollToBottom_data() { addModels(); }
+    void scrollToBottom();
+    void pagedScroll_data() { addModels(); }
+    void pagedScroll();
+    void widthChange_data() { addModels(); }
+    void widthChange();
+    void prepend_data() { addModels(); }
+    void prepend();
+    void bulkRemove_data() { addModels(); }
+    void bulkRemove();
+    void dataChangedChurn_data() { addModels(); }
+    void dataChangedChurn();
+    void removeAndChange_data() { addModels(); }
+    void removeAndChange();
+    void positionViewAtIndex_data() { addModels(); }
+    void positionViewAtIndex();
+
+private:
+    QQmlEngine engine;
+
+    void addModels();
+    AspectModel *createModel();
+};
+
+void LayoutBenchmark::initTestCase()
+{
+    qmlRegisterType<FittingGridView>("FittingGridView", 1, 0, "FittingGridView");
+}
+
+void LayoutBenchmark::addModels()
+{
+    QTest::addColumn<int>("count");
+    QTest::addColumn<int>("distribution");
+
+    const int counts[] = { 1000, 10000, 100000, 1000000 };
+    for (int count : counts) {
+        QTest::newRow(qPrintable(QString("%1 fixed").arg(count))) << count << int(AspectModel::Fixed);
+        QTest::newRow(qPrintable(QString("%1 random").arg(count))) << count << int(AspectModel::Random);
+    }
+}
+
+AspectModel *LayoutBenchmark::createModel()
+{
+    QFETCH(int, count);
+    QFETCH(int, distribution);
+    return new AspectModel(count, AspectModel::Distribution(distribution), this);
+}
+
+// First layout of a new view, including creating the visible delegates
+void LayoutBenchmark::coldLayout()
+{
+    QScopedPointer<AspectModel> model(createModel());
+    QBENCHMARK {
+        ViewFixture f(&engine, model.data());
+        f.layout();
+    }
+}
+
+// Jump between the top and bottom, which must find the rows at each end
+void LayoutBenchmark::scrollToBottom()
+{
+    QScopedPointer<AspectModel> model(createModel());
+    ViewFixture f(&engine, model.data());
+    f.layout();
+
+    QBENCHMARK {
+        f.scrollTo(f.contentHeight());
+        f.layout();
+        f.scrollTo(0);
+        f.layout();
+    }
+}
+
+// Scroll down one viewport at a time, as a fling does over several frames
+void LayoutBenchmark::pagedScroll()
+{
+    QScopedPointer<AspectModel> model(createModel());
+    ViewFixture f(&engine, model.data());
+    f.layout();
+
+    QBENCHMARK {
+        f.scrollTo(0);
+        f.layout();
+        for (int i = 1; i <= 50; i++) {
+            f.scrollTo(i * f.view->height());
+            f.layout();
+        }
+    }
+}
+
+// Reflow every row for a different width, e.g. rotating or resizing the window
+void LayoutBenchmark::widthChange()
+{
+    QScopedPointer<AspectModel> model(createModel());
+    ViewFixture f(&engine, model.data());
+    f.layout();
+
+    QBENCHMARK {
+        f.view->setWidth(f.view->width() == 800 ? 640 : 800);
+        f.layout();
+    }
+}
+
+// New items arriving at the top of a timeline
+void LayoutBenchmark::prepend()
+{
+    QScopedPointer<AspectModel> model(createModel());
+    ViewFixture f(&engine, model.data());
+    f.layout();
+
+    QBENCHMARK {
+        model->prepend(10);
+        f.layout();
+    }
+}
+
+// Deleting a selection from the middle while it's visible
+void LayoutBenchmark::bulkRemove()
+{
+    QScopedPointer<AspectModel> model(createModel());
+    ViewFixture f(&engine, model.data());
+    f.layout();
+    f.scrollTo(f.contentHeight() / 2);
+    f.layout();
+
+    QBENCHMARK_ONCE {
+        model->remove(model->rowCount() / 2, qMin(1000, model->rowCount() / 10));
+        f.layout();
+    }
+}
+
+// Items changing in place, e.g. as their metadata is loaded
+void LayoutBenchmark::dataChangedChurn()
+{
+    QScopedPointer<AspectModel> model(createModel());
+    ViewFixture f(&engine, model.data());
+    f.layout();
+
+    QBENCHMARK {
+        model->churn(100);
+        f.layout();
+    }
+}
+
+// Deleting whole rows at the top and items after them changing in the same batch, which
+// remaps rows and changes aspects in one layout
+void LayoutBenchmark::removeAndChange()
+{
+    QScopedPointer<AspectModel> model(createModel());
+    ViewFixture f(&engine, model.data());
+    f.layout();
+
+    QBENCHMARK_ONCE {
+        model->remove(0, 100);
+        model->change(50, 20);
+        f.layout();
+    }
+}
+
+// Jump straight to items far apart, e.g. from search results or a date scrubber
+void LayoutBenchmark::positionViewAtIndex()
+{
+    QScopedPointer<AspectModel> model(createModel());
+    ViewFixture f(&engine, model.data());
+    f.layout();
+
+    QBENCHMARK {
+        f.view->positionViewAtIndex(model->rowCount() - 1, FittingGridView::End);
+        f.layout();
+        f.view->positionViewAtIndex(model->rowCount() / 2, FittingGridView::Center);
+        f.layout();
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    QGuiApplication app(argc, argv);
+
+    // Results are CSV unless another output format is requested
+    QStringList args = app.arguments();
+    static const char *formats[] = { "-o", "-csv", "-xml", "-xunitxml", "-lightxml", "-txt", "-teamcity", "-tap" };
+    bool hasFormat = false;
+    for (const char *format : formats)
+        hasFormat |= args.contains(QLatin1String(format));
+    if (!hasFormat)
+        args.insert(1, "-csv");
+
+    LayoutBenchmark benchmark;
+    return QTest::qExec(&benchmark, args);
+}
+
+#include "tst_bench_layout.moc"
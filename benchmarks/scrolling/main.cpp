@@ -0,0 +1,305 @@
+/* Copyright (c) 2013 John Brooks <john.brooks@dereferenced.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "fittinggridview.h"
+#include "aspectmodel.h"
+#include <QGuiApplication>
+#include <QQmlEngine>
+#include <QQmlComponent>
+#include <QQmlContext>
+#include <QQuickWindow>
+#include <QQuickRenderControl>
+#include <QQuickImageProvider>
+#include <QAnimationDriver>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <algorithm>
+#include <functional>
+
+/* Scrolls each view offscreen with the software scenegraph backend, rendering every frame
+ * through QQuickRenderControl, and prints percentiles of the time spent in each phase of
+ * a frame as CSV.
+ */
+
+// Advances animations by exactly one frame at a time, so flicks cover the same distance
+// regardless of how long frames take to render
+class FrameAnimationDriver : public QAnimationDriver
+{
+public:
+    FrameAnimationDriver()
+        : m_elapsed(0)
+    {
+    }
+
+    void advanceFrame()
+    {
+        m_elapsed += 16;
+        advance();
+    }
+
+    virtual qint64 elapsed() const
+    {
+        return m_elapsed;
+    }
+
+private:
+    qint64 m_elapsed;
+};
+
+// Solid images with the size and aspect of each item, for delegates that decode and upload
+// an image without reading any files. Ids are "<width>x<height>/<key>".
+class SwatchImageProvider : public QQuickImageProvider
+{
+public:
+    SwatchImageProvider()
+        : QQuickImageProvider(QQuickImageProvider::Image)
+    {
+    }
+
+    virtual QImage requestImage(const QString &id, QSize *size, const QSize &requestedSize)
+    {
+        QStringList parts = id.split('/');
+        QStringList dimensions = parts.value(0).split('x');
+        QSize imageSize(dimensions.value(0).toInt(), dimensions.value(1).toInt());
+        if (imageSize.isEmpty())
+            imageSize = QSize(1, 1);
+        if (requestedSize.height() > 0)
+            imageSize = QSize(qMax(1, imageSize.width() * requestedSize.height() / imageSize.height()), requestedSize.height());
+
+        QImage image(imageSize, QImage::Format_RGB32);
+        image.fill(QColor::fromHsv(qHash(parts.value(1)) % 360, 128, 200));
+        if (size)
+            *size = imageSize;
+        return image;
+    }
+};
+
+struct ViewType
+{
+    const char *name;
+    const char *qml;
+    // Moves the current item down by one row
+    const char *nextRowMethod;
+};
+
+static const ViewType viewTypes[] = {
+    { "FittingGridView",
+      "FittingGridView {\n"
+      "    anchors.fill: parent\n"
+      "    model: benchmarkModel\n"
+      "    aspectRatioRole: \"aspectRatio\"\n"
+      "    currentIndex: 0\n"
+      "    delegate: Image {\n"
+      "        source: \"image://swatch/\" + model.width + \"x\" + model.height + \"/\" + model.key\n"
+      "        sourceSize.height: 256\n"
+      "    }\n"
+      "}\n",
+      "incrementCurrentRow" },
+    { "GridView",
+      "GridView {\n"
+      "    anchors.fill: parent\n"
+      "    model: benchmarkModel\n"
+      "    cellWidth: 200; cellHeight: 150\n"
+      "    currentIndex: 0\n"
+      "    delegate: Image {\n"
+      "        width: 198; height: 148\n"
+      "        fillMode: Image.PreserveAspectCrop\n"
+      "        source: \"image://swatch/\" + model.width + \"x\" + model.height + \"/\" + model.key\n"
+      "        sourceSize.height: 256\n"
+      "    }\n"
+      "}\n",
+      "moveCurrentIndexDown" },
+    { "ListView",
+      "ListView {\n"
+      "    anchors.fill: parent\n"
+      "    model: benchmarkModel\n"
+      "    currentIndex: 0\n"
+      "    delegate: Image {\n"
+      "        width: ListView.view.width; height: width / model.aspectRatio\n"
+      "        source: \"image://swatch/\" + model.width + \"x\" + model.height + \"/\" + model.key\n"
+      "        sourceSize.height: 256\n"
+      "    }\n"
+      "}\n",
+      "incrementCurrentIndex" },
+};
+
+struct FrameTimes
+{
+    QVector<double> polish;
+    QVector<double> sync;
+    QVector<double> render;
+};
+
+class Scene
+{
+public:
+    Scene(QQmlEngine *engine, AspectModel *model, const ViewType &type);
+    ~Scene();
+
+    QQuickItem *item() const { return view; }
+    QQuickItem *flickable() const;
+    void frames(int count, FrameTimes *times, std::function<void(int)> beforeFrame);
+
+private:
+    QQuickRenderControl *control;
+    QQuickWindow *window;
+    FrameAnimationDriver driver;
+    QQuickItem *root;
+    QQuickItem *view;
+};
+
+Scene::Scene(QQmlEngine *engine, AspectModel *model, const ViewType &type)
+    : control(new QQuickRenderControl)
+    , window(new QQuickWindow(control))
+    , root(0)
+    , view(0)
+{
+    driver.install();
+    window->resize(800, 600);
+    window->contentItem()->setSize(QSizeF(800, 600));
+    control->initialize(0);
+
+    QQmlContext *context = new QQmlContext(engine->rootContext(), window);
+    context->setContextProperty("benchmarkModel", model);
+
+    QQmlComponent component(engine);
+    component.setData(QByteArray("import QtQuick 2.0\n"
+                                 "import FittingGridView 1.0\n"
+                                 "Item {\n"
+                                 "    width: 800; height: 600\n")
+                      + type.qml + "}\n", QUrl());
+    root = qobject_cast<QQuickItem*>(component.create(context));
+    if (!root)
+        qFatal("Cannot create %s: %s", type.name, qPrintable(component.errorString()));
+    root->setParentItem(window->contentItem());
+    view = root->childItems().value(0);
+}
+
+Scene::~Scene()
+{
+    delete root;
+    // The render control frees the scenegraph, which must happen before the window is gone
+    delete control;
+    delete window;
+    driver.uninstall();
+}
+
+QQuickItem *Scene::flickable() const
+{
+    if (FittingGridView *grid = qobject_cast<FittingGridView*>(view))
+        return grid->flickable();
+    return view;
+}
+
+void Scene::frames(int count, FrameTimes *times, std::function<void(int)> beforeFrame)
+{
+    QElapsedTimer timer;
+    for (int i = 0; i < count; i++) {
+        beforeFrame(i);
+        driver.advanceFrame();
+
+        timer.start();
+        control->polishItems();
+        times->polish.append(timer.nsecsElapsed() / 1e6);
+
+        timer.start();
+        control->sync();
+        times->sync.append(timer.nsecsElapsed() / 1e6);
+
+        // The software backend only renders into an image when grabbing
+        timer.start();
+        control->grab();
+        times->render.append(timer.nsecsElapsed() / 1e6);
+    }
+}
+
+static double percentile(QVector<double> values, double p)
+{
+    if (values.isEmpty())
+        return 0;
+    std::sort(values.begin(), values.end());
+    return values[qMin(values.size() - 1, int(p * (values.size() - 1) + 0.5))];
+}
+
+static void report(QTextStream &out, const char *view, const char *scenario, const char *phase,
+                   const QVector<double> &values)
+{
+    out << view << ',' << scenario << ',' << phase << ',' << values.size() << ','
+        << percentile(values, 0.5) << ',' << percentile(values, 0.9) << ','
+        << percentile(values, 0.99) << ',' << percentile(values, 1) << '\n';
+}
+
+static void report(QTextStream &out, const char *view, const char *scenario, const FrameTimes &times)
+{
+    report(out, view, scenario, "polish", times.polish);
+    report(out, view, scenario, "sync", times.sync);
+    report(out, view, scenario, "render", times.render);
+}
+
+int main(int argc, char **argv)
+{
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    QQuickWindow::setSceneGraphBackend(QSGRendererInterface::Software);
+    QGuiApplication app(argc, argv);
+
+    // Usage: bench_scrolling [count] [fixed|random]
+    QStringList args = app.arguments();
+    int count = args.value(1, "10000").toInt();
+    AspectModel::Distribution distribution = (args.value(2) == "fixed") ? AspectModel::Fixed : AspectModel::Random;
+
+    qmlRegisterType<FittingGridView>("FittingGridView", 1, 0, "FittingGridView");
+    QQmlEngine engine;
+    engine.addImageProvider("swatch", new SwatchImageProvider);
+
+    QTextStream out(stdout);
+    out << "view,scenario,phase,frames,p50_ms,p90_ms,p99_ms,max_ms\n";
+
+    for (const ViewType &type : viewTypes) {
+        AspectModel model(count, distribution);
+
+        {
+            // Five flings down, each given a second to play out
+            Scene scene(&engine, &model, type);
+            FrameTimes times;
+            scene.frames(5 * 60, &times, [&scene](int frame) {
+                if (!(frame % 60))
+                    QMetaObject::invokeMethod(scene.flickable(), "flick", Q_ARG(qreal, 0), Q_ARG(qreal, -4000));
+            });
+            report(out, type.name, "fling", times);
+        }
+
+        {
+            // Hold the down key: one row per frame. GridView and ListView scroll to the current
+            // item themselves; FittingGridView has to be positioned to scroll as far.
+            Scene scene(&engine, &model, type);
+            QQuickItem *view = scene.item();
+            FrameTimes times;
+            scene.frames(300, &times, [view, &type](int) {
+                QMetaObject::invokeMethod(view, type.nextRowMethod);
+                if (FittingGridView *grid = qobject_cast<FittingGridView*>(view))
+                    grid->positionViewAtIndex(grid->currentIndex(), FittingGridView::Contain);
+            });
+            report(out, type.name, "keyboard", times);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,9 @@
+TEMPLATE = app
+TARGET = bench_scrolling
+CONFIG += console
+CONFIG -= app_bundle
+
+include(../shared/shared.pri)
+
+SOURCES += \
+    main.cpp
@@ -0,0 +1,137 @@
+/* Copyright (c) 2013 John Brooks <john.brooks@dereferenced.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "aspectmodel.h"
+
+AspectModel::AspectModel(int count, Distribution distribution, QObject *parent)
+    : QAbstractListModel(parent)
+    , m_distribution(distribution)
+    , m_random(count)
+    , m_nextKey(0)
+{
+    m_aspects.reserve(count);
+    m_keys.reserve(count);
+    for (int i = 0; i < count; i++) {
+        m_aspects.append(nextAspect());
+        m_keys.append(m_nextKey++);
+    }
+}
+
+int AspectModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : m_aspects.size();
+}
+
+QVariant AspectModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= m_aspects.size())
+        return QVariant();
+
+    double aspect = m_aspects[index.row()];
+    switch (role) {
+    case AspectRatioRole:
+        return aspect;
+    case WidthRole:
+        return qRound(aspect * 1000);
+    case HeightRole:
+        return 1000;
+    case KeyRole:
+        return QString::fromLatin1("item%1").arg(m_keys[index.row()]);
+    }
+    return QVariant();
+}
+
+QHash<int, QByteArray> AspectModel::roleNames() const
+{
+    QHash<int, QByteArray> roles;
+    roles.insert(AspectRatioRole, "aspectRatio");
+    roles.insert(WidthRole, "width");
+    roles.insert(HeightRole, "height");
+    roles.insert(KeyRole, "key");
+    return roles;
+}
+
+void AspectModel::insert(int index, int count)
+{
+    if (count <= 0)
+        return;
+
+    beginInsertRows(QModelIndex(), index, index + count - 1);
+    m_aspects.insert(index, count, 0);
+    m_keys.insert(index, count, 0);
+    for (int i = index; i < index + count; i++) {
+        m_aspects[i] = nextAspect();
+        m_keys[i] = m_nextKey++;
+    }
+    endInsertRows();
+}
+
+void AspectModel::remove(int index, int count)
+{
+    count = qMin(count, m_aspects.size() - index);
+    if (count <= 0)
+        return;
+
+    beginRemoveRows(QModelIndex(), index, index + count - 1);
+    m_aspects.remove(index, count);
+    m_keys.remove(index, count);
+    endRemoveRows();
+}
+
+void AspectModel::churn(int count)
+{
+    if (m_aspects.isEmpty())
+        return;
+
+    std::uniform_int_distribution<int> indexes(0, m_aspects.size() - 1);
+    QVector<int> roles;
+    roles << AspectRatioRole << WidthRole;
+    for (int i = 0; i < count; i++) {
+        int row = indexes(m_random);
+        m_aspects[row] = nextAspect();
+        emit dataChanged(this->index(row), this->index(row), roles);
+    }
+}
+
+void AspectModel::change(int index, int count)
+{
+    count = qMin(count, m_aspects.size() - index);
+    if (count <= 0)
+        return;
+
+    for (int i = index; i < index + count; i++)
+        m_aspects[i] = nextAspect();
+    QVector<int> roles;
+    roles << AspectRatioRole << WidthRole;
+    emit dataChanged(this->index(index), this->index(index + count - 1), roles);
+}
+
+double AspectModel::nextAspect()
+{
+    if (m_distribution == Fixed)
+        return 1.5;
+
+    // Roughly how often each shape shows up in a photo library
+    static const double aspects[] = { 4.0/3, 3.0/2, 3.0/4, 2.0/3, 16.0/9, 9.0/16, 1, 3 };
+    static const double weights[] = { 30, 20, 15, 10, 10, 8, 5, 2 };
+    static std::discrete_distribution<int> shapes(std::begin(weights), std::end(weights));
+    std::uniform_real_distribution<double> jitter(0.95, 1.05);
+    return aspects[shapes(m_random)] * jitter(m_random);
+}
@@ -0,0 +1,77 @@
+/* Copyright (c) 2013 John Brooks <john.brooks@dereferenced.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef ASPECTMODEL_H
+#define ASPECTMODEL_H
+
+#include <QAbstractListModel>
+#include <QVector>
+#include <random>
+
+/* List model of synthetic items with only an aspect ratio, for driving the view with
+ * any number of items without loading anything.
+ *
+ * Roles are aspectRatio, width and height (in pixels, at a height of 1000) and key, which
+ * is unique to each item for as long as it exists.
+ */
+class AspectModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    enum Distribution {
+        // Every item is 3:2
+        Fixed,
+        // A mix of common photo aspects, from portrait to panorama
+        Random
+    };
+
+    enum Roles {
+        AspectRatioRole = Qt::UserRole,
+        WidthRole,
+        HeightRole,
+        KeyRole
+    };
+
+    AspectModel(int count, Distribution distribution, QObject *parent = 0);
+
+    virtual int rowCount(const QModelIndex &parent = QModelIndex()) const;
+    virtual QVariant data(const QModelIndex &index, int role) const;
+    virtual QHash<int, QByteArray> roleNames() const;
+
+    void insert(int index, int count);
+    void prepend(int count) { insert(0, count); }
+    void remove(int index, int count);
+    // Give count random items a new aspect, with a dataChanged signal for each
+    void churn(int count);
+    // Give the items from index a new aspect, with one dataChanged signal
+    void change(int index, int count);
+
+private:
+    Distribution m_distribution;
+    std::mt19937 m_random;
+    QVector<double> m_aspects;
+    QVector<int> m_keys;
+    int m_nextKey;
+
+    double nextAspect();
+};
+
+#endif // ASPECTMODEL_H
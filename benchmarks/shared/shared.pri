@@ -0,0 +1,13 @@
+# Builds the view directly into each benchmark, along with the synthetic model
+QT += qml quick quick-private qml-private core-private gui-private
+CONFIG += c++11
+
+include(../../fittinggridview.pri)
+
+INCLUDEPATH += $$PWD
+
+SOURCES += \
+    $$PWD/aspectmodel.cpp
+
+HEADERS += \
+    $$PWD/aspectmodel.h
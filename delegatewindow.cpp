@@ -0,0 +1,185 @@
+/* Copyright (c) 2013 John Brooks <john.brooks@dereferenced.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "delegatewindow_p.h"
+#include <algorithm>
+
+DelegateWindow::DelegateWindow()
+    : m_base(0)
+{
+}
+
+int DelegateWindow::lowerBound(int index) const
+{
+    int offset = index - m_base;
+    if (offset <= 0)
+        return 0;
+
+    // Most windows have no holes, so the offset is usually also the position
+    if (offset < m_entries.size() && m_entries[offset].offset == offset)
+        return offset;
+
+    auto it = std::lower_bound(m_entries.begin(), m_entries.end(), offset,
+        [](const Entry &e, int o) { return e.offset < o; });
+    return it - m_entries.begin();
+}
+
+QQuickItem *DelegateWindow::value(int index) const
+{
+    int i = lowerBound(index);
+    if (i < m_entries.size() && indexAt(i) == index)
+        return m_entries[i].item;
+    return 0;
+}
+
+void DelegateWindow::insert(int index, QQuickItem *item)
+{
+    if (m_entries.isEmpty())
+        m_base = index;
+
+    if (index < m_base) {
+        // New first index; keep offsets relative to it
+        int delta = m_base - index;
+        for (Entry &e : m_entries)
+            e.offset += delta;
+        m_base = index;
+    }
+
+    int i = lowerBound(index);
+    if (i < m_entries.size() && indexAt(i) == index) {
+        m_entries[i].item = item;
+        return;
+    }
+
+    Entry e = { index - m_base, item };
+    m_entries.insert(i, e);
+}
+
+QQuickItem *DelegateWindow::take(int index)
+{
+    int i = lowerBound(index);
+    if (i >= m_entries.size() || indexAt(i) != index)
+        return 0;
+
+    QQuickItem *item = m_entries[i].item;
+    m_entries.remove(i);
+    if (i == 0)
+        rebase();
+    return item;
+}
+
+void DelegateWindow::removeIf(const std::function<bool(int,QQuickItem*)> &func)
+{
+    int out = 0;
+    for (int i = 0; i < m_entries.size(); i++) {
+        if (!func(indexAt(i), m_entries[i].item))
+            m_entries[out++] = m_entries[i];
+    }
+    m_entries.resize(out);
+    rebase();
+}
+
+void DelegateWindow::insertRange(int index, int count)
+{
+    if (index <= m_base) {
+        m_base += count;
+        return;
+    }
+
+    for (int i = lowerBound(index); i < m_entries.size(); i++)
+        m_entries[i].offset += count;
+}
+
+void DelegateWindow::removeRange(int index, int count, const std::function<void(QQuickItem*)> &removeFunc)
+{
+    if (m_entries.isEmpty() || count <= 0)
+        return;
+
+    int out = 0;
+    for (int i = 0; i < m_entries.size(); i++) {
+        int itemIndex = indexAt(i);
+        if (itemIndex >= index + count) {
+            m_entries[out].item = m_entries[i].item;
+            m_entries[out++].offset = itemIndex - count - m_base;
+        } else if (itemIndex >= index) {
+            if (removeFunc)
+                removeFunc(m_entries[i].item);
+        } else {
+            m_entries[out++] = m_entries[i];
+        }
+    }
+    m_entries.resize(out);
+
+    // Offsets may now be negative if the range started before the base
+    if (!m_entries.isEmpty() && m_entries.first().offset < 0) {
+        int delta = -m_entries.first().offset;
+        for (Entry &e : m_entries)
+            e.offset += delta;
+        m_base -= delta;
+    }
+    rebase();
+}
+
+void DelegateWindow::remap(const std::function<int(int)> &map, const std::function<void(QQuickItem*)> &removeFunc)
+{
+    // Offsets temporarily hold the new indexes
+    int out = 0;
+    bool sorted = true;
+    for (int i = 0; i < m_entries.size(); i++) {
+        int index = map(indexAt(i));
+        if (index < 0) {
+            if (removeFunc)
+                removeFunc(m_entries[i].item);
+            continue;
+        }
+
+        if (out && index < m_entries[out-1].offset)
+            sorted = false;
+        m_entries[out].item = m_entries[i].item;
+        m_entries[out++].offset = index;
+    }
+    m_entries.resize(out);
+
+    // Moves can reorder delegates
+    if (!sorted) {
+        std::sort(m_entries.begin(), m_entries.end(),
+            [](const Entry &a, const Entry &b) { return a.offset < b.offset; });
+    }
+
+    m_base = 0;
+    rebase();
+}
+
+void DelegateWindow::clear()
+{
+    m_entries.clear();
+    m_base = 0;
+}
+
+void DelegateWindow::rebase()
+{
+    if (m_entries.isEmpty() || !m_entries.first().offset)
+        return;
+
+    int delta = m_entries.first().offset;
+    for (Entry &e : m_entries)
+        e.offset -= delta;
+    m_base += delta;
+}
@@ -0,0 +1,79 @@
+/* Copyright (c) 2013 John Brooks <john.brooks@dereferenced.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef DELEGATEWINDOW_P_H
+#define DELEGATEWINDOW_P_H
+
+#include <QVector>
+#include <functional>
+
+class QQuickItem;
+
+/* Delegates that currently exist, which are almost always a small window of
+ * consecutive indexes around the visible rows.
+ *
+ * Items are kept sorted in a flat array and keyed by their offset from the first
+ * index in the window, so inserting or removing model rows before the window only
+ * moves the base index. Lookups within a dense window are direct.
+ */
+class DelegateWindow
+{
+public:
+    DelegateWindow();
+
+    int count() const { return m_entries.size(); }
+    bool isEmpty() const { return m_entries.isEmpty(); }
+
+    // Index and item of the i'th delegate in index order
+    int indexAt(int i) const { return m_base + m_entries[i].offset; }
+    QQuickItem *itemAt(int i) const { return m_entries[i].item; }
+
+    QQuickItem *value(int index) const;
+    void insert(int index, QQuickItem *item);
+    QQuickItem *take(int index);
+
+    // Remove all delegates for which func returns true
+    void removeIf(const std::function<bool(int,QQuickItem*)> &func);
+
+    // Shift indexes for count items inserted or removed at index. Delegates for
+    // removed indexes are passed to removeFunc.
+    void insertRange(int index, int count);
+    void removeRange(int index, int count, const std::function<void(QQuickItem*)> &removeFunc = nullptr);
+    // Move every delegate to the index returned by map in one pass. Delegates mapped to -1
+    // are passed to removeFunc.
+    void remap(const std::function<int(int)> &map, const std::function<void(QQuickItem*)> &removeFunc = nullptr);
+
+    void clear();
+
+private:
+    struct Entry {
+        int offset;
+        QQuickItem *item;
+    };
+
+    int m_base;
+    QVector<Entry> m_entries;
+
+    // Position of the first entry at or after index
+    int lowerBound(int index) const;
+    void rebase();
+};
+
+#endif // DELEGATEWINDOW_P_H
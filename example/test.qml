@@ -30,7 +30,7 @@ FittingGridView {
             url: "10491-pink-floyd-6.jpg"
         }
     }
-    delegate: Image {
+    delegate: FittingGridImage {
         source: "img/" + model.url
     }
 }
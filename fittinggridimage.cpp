@@ -0,0 +1,308 @@
+/* Copyright (c) 2013 John Brooks <john.brooks@dereferenced.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "fittinggridimage.h"
+#include "tracing_p.h"
+#include <QtQml/private/qqmlfile_p.h>
+#include <QAtomicInt>
+#include <QImageIOHandler>
+#include <QImageReader>
+#include <QMutex>
+#include <QQmlContext>
+#include <QQuickWindow>
+#include <QRunnable>
+#include <QSGSimpleTextureNode>
+#include <QThread>
+#include <QThreadPool>
+#include <QDebug>
+#include <qmath.h>
+
+class FittingGridImageJob
+{
+public:
+    FittingGridImageJob()
+        : height(0)
+        , receiver(0)
+        , finished(false)
+    {
+    }
+
+    QString path;
+    // Decode at most this many pixels high, or only read the header if 0
+    int height;
+    QAtomicInt cancelled;
+
+    QMutex mutex;
+    // Cleared when the item no longer wants the result
+    FittingGridImage *receiver;
+    bool finished;
+    QSize fileSize;
+    QImage image;
+};
+
+namespace {
+
+// Decoding is limited by memory bandwidth as much as by CPU, and the GUI and render threads
+// need cores of their own while scrolling
+class ReadPool : public QThreadPool
+{
+public:
+    ReadPool()
+    {
+        setMaxThreadCount(qBound(1, QThread::idealThreadCount() - 2, 4));
+    }
+};
+
+Q_GLOBAL_STATIC(ReadPool, readPool)
+
+class ReadTask : public QRunnable
+{
+public:
+    explicit ReadTask(const QSharedPointer<FittingGridImageJob> &job)
+        : m_job(job)
+    {
+    }
+
+    void run();
+
+private:
+    QSharedPointer<FittingGridImageJob> m_job;
+};
+
+void ReadTask::run()
+{
+    if (m_job->cancelled.load())
+        return;
+
+    TRACE("readImage");
+    QImageReader reader(m_job->path);
+    // Photos are shown with their EXIF orientation applied, as the view's header probes measure
+    // them; orientations 5 to 8 swap width and height, but are scaled before being rotated
+    reader.setAutoTransform(true);
+    bool rotated = reader.transformation() & QImageIOHandler::TransformationRotate90;
+    QSize fileSize = reader.size();
+    if (rotated)
+        fileSize.transpose();
+    QImage image;
+
+    // Some formats can't tell their size without decoding
+    if ((m_job->height > 0 || !fileSize.isValid()) && !m_job->cancelled.load()) {
+        if (fileSize.isValid() && m_job->height > 0 && fileSize.height() > m_job->height) {
+            QSize scaled = fileSize.scaled(fileSize.width(), m_job->height, Qt::KeepAspectRatio);
+            reader.setScaledSize(rotated ? scaled.transposed() : scaled);
+        }
+        image = reader.read();
+        if (!fileSize.isValid())
+            fileSize = image.size();
+    }
+
+    QMutexLocker locker(&m_job->mutex);
+    m_job->finished = true;
+    m_job->fileSize = fileSize;
+    m_job->image = image;
+    // Events posted to an object are discarded when it's destroyed, so this only has to
+    // happen while the receiver is still set
+    if (m_job->receiver)
+        QMetaObject::invokeMethod(m_job->receiver, "readFinished", Qt::QueuedConnection);
+}
+
+}
+
+FittingGridImage::FittingGridImage(QQuickItem *parent)
+    : QQuickItem(parent)
+    , m_status(Null)
+    , m_imageChanged(false)
+{
+    setFlag(ItemHasContents);
+}
+
+FittingGridImage::~FittingGridImage()
+{
+    cancel();
+}
+
+void FittingGridImage::setSource(const QUrl &source)
+{
+    if (m_source == source)
+        return;
+
+    cancel();
+    m_source = source;
+    m_path.clear();
+    m_fileSize = QSize();
+    if (!m_image.isNull()) {
+        m_image = QImage();
+        m_imageChanged = true;
+        update();
+        emit sourceSizeChanged();
+    }
+    setImplicitSize(0, 0);
+    setStatus(Null);
+    load();
+    emit sourceChanged();
+}
+
+void FittingGridImage::cancel()
+{
+    if (!m_job)
+        return;
+
+    m_job->cancelled.store(1);
+    {
+        QMutexLocker locker(&m_job->mutex);
+        m_job->receiver = 0;
+    }
+    m_job.clear();
+}
+
+void FittingGridImage::componentComplete()
+{
+    QQuickItem::componentComplete();
+    load();
+}
+
+void FittingGridImage::geometryChanged(const QRectF &newGeometry, const QRectF &oldGeometry)
+{
+    QQuickItem::geometryChanged(newGeometry, oldGeometry);
+    if (newGeometry.height() > oldGeometry.height())
+        load();
+}
+
+void FittingGridImage::itemChange(ItemChange change, const ItemChangeData &value)
+{
+    QQuickItem::itemChange(change, value);
+    // Shown again after being released, or moved to a window with a different pixel ratio
+    if ((change == ItemVisibleHasChanged && value.boolValue) || change == ItemSceneChange)
+        load();
+}
+
+int FittingGridImage::targetHeight() const
+{
+    qreal ratio = window() ? window()->effectiveDevicePixelRatio() : 1;
+    return qCeil(height() * ratio);
+}
+
+// Start reading the header, or decoding at the displayed size, if either is still needed
+void FittingGridImage::load()
+{
+    if (m_job || !isComponentComplete() || m_status == Error)
+        return;
+
+    if (m_source.isEmpty()) {
+        setStatus(Null);
+        return;
+    }
+
+    if (m_path.isEmpty()) {
+        QQmlContext *context = qmlContext(this);
+        m_path = QQmlFile::urlToLocalFileOrQrc(context ? context->resolvedUrl(m_source) : m_source);
+        if (m_path.isEmpty()) {
+            qWarning() << "FittingGridImage: only local files are supported" << m_source;
+            setStatus(Error);
+            return;
+        }
+    }
+
+    // The first read only gets the header unless the item is already sized and shown. Items
+    // are decoded again when they grow past the pixels they have, but never when they shrink.
+    int height = isVisible() ? targetHeight() : 0;
+    if (m_fileSize.isValid()) {
+        height = qMin(height, m_fileSize.height());
+        if (height <= 0 || m_image.height() >= height)
+            return;
+    }
+
+    QSharedPointer<FittingGridImageJob> job(new FittingGridImageJob);
+    job->path = m_path;
+    job->height = height;
+    job->receiver = this;
+    m_job = job;
+    setStatus(m_image.isNull() ? Loading : Ready);
+    readPool()->start(new ReadTask(job));
+}
+
+void FittingGridImage::readFinished()
+{
+    QSharedPointer<FittingGridImageJob> job = m_job;
+    if (!job)
+        return;
+    {
+        // Left over from a job that was replaced
+        QMutexLocker locker(&job->mutex);
+        if (!job->finished)
+            return;
+    }
+    m_job.clear();
+
+    if (!job->fileSize.isValid()) {
+        qWarning() << "FittingGridImage: cannot read" << m_source;
+        setStatus(Error);
+        return;
+    }
+
+    m_fileSize = job->fileSize;
+    setImplicitSize(m_fileSize.width(), m_fileSize.height());
+
+    if (!job->image.isNull()) {
+        m_image = job->image;
+        m_imageChanged = true;
+        update();
+        setStatus(Ready);
+        emit sourceSizeChanged();
+    }
+
+    // The item may have been sized or shown while reading
+    load();
+}
+
+void FittingGridImage::setStatus(Status status)
+{
+    if (m_status == status)
+        return;
+
+    m_status = status;
+    emit statusChanged();
+}
+
+QSGNode *FittingGridImage::updatePaintNode(QSGNode *oldNode, UpdatePaintNodeData *data)
+{
+    Q_UNUSED(data);
+
+    QSGSimpleTextureNode *node = static_cast<QSGSimpleTextureNode*>(oldNode);
+    if (m_image.isNull() || width() <= 0 || height() <= 0) {
+        delete node;
+        return 0;
+    }
+
+    if (!node) {
+        node = new QSGSimpleTextureNode;
+        node->setOwnsTexture(true);
+        node->setFiltering(QSGTexture::Linear);
+    }
+
+    if (m_imageChanged || !node->texture()) {
+        node->setTexture(window()->createTextureFromImage(m_image));
+        m_imageChanged = false;
+    }
+
+    // The view sizes items to the aspect ratio of the image
+    node->setRect(boundingRect());
+    return node;
+}
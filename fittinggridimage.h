@@ -0,0 +1,99 @@
+/* Copyright (c) 2013 John Brooks <john.brooks@dereferenced.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef FITTINGGRIDIMAGE_H
+#define FITTINGGRIDIMAGE_H
+
+#include <QQuickItem>
+#include <QImage>
+#include <QSharedPointer>
+#include <QUrl>
+
+class FittingGridImageJob;
+
+/* An image delegate for FittingGridView, which is sized by the view.
+ *
+ * Only the header of the file is read until the item has a height, which is enough for the
+ * implicit size and so for the view's layout. The image is then decoded on a shared, bounded
+ * thread pool at the size it's displayed at, and decoded again only if the item grows.
+ * Pending reads are cancelled when the source changes, or when the view releases the item.
+ *
+ * Only local files and resources are supported.
+ */
+class FittingGridImage : public QQuickItem
+{
+    Q_OBJECT
+    Q_ENUMS(Status)
+
+public:
+    enum Status {
+        Null,
+        Ready,
+        Loading,
+        Error
+    };
+
+    explicit FittingGridImage(QQuickItem *parent = 0);
+    ~FittingGridImage();
+
+    Q_PROPERTY(QUrl source READ source WRITE setSource NOTIFY sourceChanged)
+    QUrl source() const { return m_source; }
+    void setSource(const QUrl &source);
+
+    Q_PROPERTY(Status status READ status NOTIFY statusChanged)
+    Status status() const { return m_status; }
+
+    // Size the image was decoded at, which is never larger than the file
+    Q_PROPERTY(QSize sourceSize READ sourceSize NOTIFY sourceSizeChanged)
+    QSize sourceSize() const { return m_image.size(); }
+
+    // Stop any read that hasn't finished; it's started again if the item is shown
+    void cancel();
+
+signals:
+    void sourceChanged();
+    void statusChanged();
+    void sourceSizeChanged();
+
+protected:
+    virtual void componentComplete();
+    virtual void geometryChanged(const QRectF &newGeometry, const QRectF &oldGeometry);
+    virtual void itemChange(ItemChange change, const ItemChangeData &value);
+    virtual QSGNode *updatePaintNode(QSGNode *oldNode, UpdatePaintNodeData *data);
+
+private slots:
+    void readFinished();
+
+private:
+    QUrl m_source;
+    QString m_path;
+    Status m_status;
+    // Size of the image in the file, once the header has been read
+    QSize m_fileSize;
+    QImage m_image;
+    bool m_imageChanged;
+    QSharedPointer<FittingGridImageJob> m_job;
+
+    int targetHeight() const;
+    void load();
+    void setStatus(Status status);
+};
+
+#endif // FITTINGGRIDIMAGE_H
@@ -20,11 +20,20 @@
 
 #include "fittinggridview.h"
 #include "fittinggridview_p.h"
+#include "fittinggridimage.h"
+#include "indexremap_p.h"
+#include "tracing_p.h"
 #include <QtQml/private/qqmldelegatemodel_p.h>
+#include <QtQml/private/qqmlfile_p.h>
 #include <QtQuick/private/qquickitem_p.h>
 #include <QQmlContext>
+#include <QQmlEngine>
+#include <QQmlIncubationController>
+#include <QUrl>
+#include <QElapsedTimer>
 #include <QDebug>
-#include <functional>
+#include <algorithm>
+#include <limits>
 
 #ifdef LAYOUT_DEBUG
 #define DEBUG() qDebug()
@@ -32,9 +41,64 @@
 #define DEBUG() if (0) qDebug()
 #endif
 
+#define STATS() if (statsEnabled()) stats
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 15, 0)
+// Number of layouts an item can stay unused in the model's reuse pool before it's destroyed
+static const int maximumPoolTime = 4;
+#endif
+
+// Fraction of the viewport height realized beyond the cache buffer on each side, so that
+// scrolling can continue that far before another layout is needed
+static const double scrollHysteresis = 0.25;
+
+// Seconds of scrolling at the current velocity that the adaptive cache buffer covers ahead
+static const double prefetchTime = 0.5;
+
+// Rows laid out again after a model change before leaving the rest to the layout walk
+static const int maximumReflowRows = 500;
+
+// Fraction of the difference to a new content height estimate applied per frame while moving
+static const double estimateSmoothing = 0.2;
+
+// Milliseconds per frame spent reading aspects ahead for the background layout
+static const int prefetchBudget = 2;
+// Aspects copied per frame into the snapshot for the background layout
+static const int snapshotSlice = 1 << 16;
+
+// Items after the first visible item whose image headers are read, and how many per batch
+static const int probeLookahead = 1000;
+static const int probeBatch = 64;
+// Most recent data changes whose image headers are read again; older ones are left to delegates
+static const int maximumProbeRechecks = 1000;
+
+// Estimated rows between the laid out rows and the viewport beyond which layout starts again
+// from an estimated index, instead of laying out every row in between
+static const int maximumJumpRows = 200;
+
+// Layouts positionViewAtIndex runs to reach the row of an item before settling for an estimate
+static const int maximumSeekPasses = 4;
+
+static double modelValue(QQmlInstanceModel *model, int index, const QString &role)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+    return model->variantValue(index, role).toDouble();
+#else
+    return model->stringValue(index, role).toDouble();
+#endif
+}
+
+static QString modelString(QQmlInstanceModel *model, int index, const QString &role)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+    return model->variantValue(index, role).toString();
+#else
+    return model->stringValue(index, role);
+#endif
+}
+
 /* Avoid layout logic during display-only updates
  * Items with 0 size can permanently stop layouts
- * Asynchronous delegate creation?
  * Content height / >maxY row updates?
  */
 
@@ -66,6 +130,9 @@ void FittingGridView::setModel(const QVariant &model)
         disconnect(d->model, SIGNAL(initItem(int,QObject*)), d, SLOT(initItem(int,QObject*)));
         disconnect(d->model, SIGNAL(createdItem(int,QObject*)), d, SLOT(createdItem(int,QObject*)));
         disconnect(d->model, SIGNAL(destroyingItem(QObject*)), d, SLOT(destroyingItem(QObject*)));
+#if QT_VERSION >= QT_VERSION_CHECK(5, 15, 0)
+        disconnect(d->model, SIGNAL(itemReused(int,QObject*)), d, SLOT(itemReused(int,QObject*)));
+#endif
     }
 
     QQmlInstanceModel *oldModel = d->model;
@@ -100,6 +167,9 @@ void FittingGridView::setModel(const QVariant &model)
         connect(d->model, SIGNAL(createdItem(int,QObject*)), d, SLOT(createdItem(int,QObject*)));
         connect(d->model, SIGNAL(initItem(int,QObject*)), d, SLOT(initItem(int,QObject*)));
         connect(d->model, SIGNAL(destroyingItem(QObject*)), d, SLOT(destroyingItem(QObject*)));
+#if QT_VERSION >= QT_VERSION_CHECK(5, 15, 0)
+        connect(d->model, SIGNAL(itemReused(int,QObject*)), d, SLOT(itemReused(int,QObject*)));
+#endif
         if (isComponentComplete()) {
             polish();
         }
@@ -152,6 +222,7 @@ void FittingGridView::setFlickable(QQuickItem *flickable)
 
     if (d->flickable) {
         disconnect(d->flickable, 0, this, 0);
+        disconnect(d->flickable, 0, d, 0);
     }
 
     d->clear();
@@ -161,7 +232,10 @@ void FittingGridView::setFlickable(QQuickItem *flickable)
     if (d->highlightItem)
         d->highlightItem->setParentItem(d->contentItem);
 
-    connect(flickable, SIGNAL(contentYChanged()), SLOT(polish()));
+    connect(flickable, SIGNAL(contentYChanged()), d, SLOT(contentYChanged()));
+    // The adaptive cache buffer goes back to being symmetric when scrolling stops
+    if (flickable->metaObject()->indexOfSignal("movementEnded()") >= 0)
+        connect(flickable, SIGNAL(movementEnded()), SLOT(polish()));
 
     emit flickableChanged();
 }
@@ -217,6 +291,23 @@ void FittingGridView::setMaximumHeight(double maximumHeight)
     emit maximumHeightChanged();
 }
 
+FittingGridView::LayoutMode FittingGridView::layoutMode() const
+{
+    Q_D(const FittingGridView);
+    return d->layoutMode;
+}
+
+void FittingGridView::setLayoutMode(LayoutMode mode)
+{
+    Q_D(FittingGridView);
+    if (d->layoutMode == mode)
+        return;
+
+    d->layoutMode = mode;
+    d->layoutChanged();
+    emit layoutModeChanged();
+}
+
 int FittingGridView::currentIndex() const
 {
     Q_D(const FittingGridView);
@@ -323,6 +414,242 @@ void FittingGridView::setCacheBuffer(int pixels)
     emit cacheBufferChanged();
 }
 
+bool FittingGridView::adaptiveCacheBuffer() const
+{
+    Q_D(const FittingGridView);
+    return d->adaptiveCacheBuffer;
+}
+
+void FittingGridView::setAdaptiveCacheBuffer(bool adaptive)
+{
+    Q_D(FittingGridView);
+    if (d->adaptiveCacheBuffer == adaptive)
+        return;
+
+    d->adaptiveCacheBuffer = adaptive;
+    polish();
+    emit adaptiveCacheBufferChanged();
+}
+
+int FittingGridView::minimumCacheBuffer() const
+{
+    Q_D(const FittingGridView);
+    return d->minimumCacheBuffer;
+}
+
+void FittingGridView::setMinimumCacheBuffer(int pixels)
+{
+    Q_D(FittingGridView);
+    if (d->minimumCacheBuffer == pixels)
+        return;
+
+    d->minimumCacheBuffer = pixels;
+    polish();
+    emit minimumCacheBufferChanged();
+}
+
+int FittingGridView::maximumCacheBuffer() const
+{
+    Q_D(const FittingGridView);
+    return d->maximumCacheBuffer;
+}
+
+void FittingGridView::setMaximumCacheBuffer(int pixels)
+{
+    Q_D(FittingGridView);
+    if (d->maximumCacheBuffer == pixels)
+        return;
+
+    d->maximumCacheBuffer = pixels;
+    polish();
+    emit maximumCacheBufferChanged();
+}
+
+QString FittingGridView::aspectCacheFile() const
+{
+    Q_D(const FittingGridView);
+    return d->aspectCache.fileName();
+}
+
+void FittingGridView::setAspectCacheFile(const QString &fileName)
+{
+    Q_D(FittingGridView);
+    QUrl url(fileName);
+    QString path = url.isLocalFile() ? url.toLocalFile() : fileName;
+    if (d->aspectCache.fileName() == path)
+        return;
+
+    d->aspectCache.save();
+    d->aspectCache.setFileName(path);
+    d->aspectsChanged();
+    emit aspectCacheFileChanged();
+}
+
+QString FittingGridView::aspectCacheKeyRole() const
+{
+    Q_D(const FittingGridView);
+    return d->aspectCacheKeyRole;
+}
+
+void FittingGridView::setAspectCacheKeyRole(const QString &role)
+{
+    Q_D(FittingGridView);
+    if (d->aspectCacheKeyRole == role)
+        return;
+
+    d->aspectCacheKeyRole = role;
+    d->aspectsChanged();
+    emit aspectCacheKeyRoleChanged();
+}
+
+bool FittingGridView::saveAspectCache()
+{
+    Q_D(FittingGridView);
+    return d->aspectCache.save();
+}
+
+bool FittingGridView::dumpTrace(const QString &path)
+{
+    return Tracer::instance()->dump(path);
+}
+
+bool FittingGridView::asynchronous() const
+{
+    Q_D(const FittingGridView);
+    return d->asynchronous;
+}
+
+void FittingGridView::setAsynchronous(bool asynchronous)
+{
+    Q_D(FittingGridView);
+    if (d->asynchronous == asynchronous)
+        return;
+
+    d->asynchronous = asynchronous;
+    polish();
+    emit asynchronousChanged();
+}
+
+int FittingGridView::incubationBudget() const
+{
+    Q_D(const FittingGridView);
+    return d->incubationBudget;
+}
+
+void FittingGridView::setIncubationBudget(int msecs)
+{
+    Q_D(FittingGridView);
+    if (d->incubationBudget == msecs)
+        return;
+
+    d->incubationBudget = msecs;
+    polish();
+    emit incubationBudgetChanged();
+}
+
+bool FittingGridView::reuseItems() const
+{
+    Q_D(const FittingGridView);
+    return d->reuseItems;
+}
+
+void FittingGridView::setReuseItems(bool reuse)
+{
+    Q_D(FittingGridView);
+    if (d->reuseItems == reuse)
+        return;
+
+    d->reuseItems = reuse;
+    if (!reuse)
+        d->trimParked(0);
+    emit reuseItemsChanged();
+}
+
+int FittingGridView::poolSize() const
+{
+    Q_D(const FittingGridView);
+    return d->poolSize;
+}
+
+void FittingGridView::setPoolSize(int size)
+{
+    Q_D(FittingGridView);
+    if (d->poolSize == size)
+        return;
+
+    d->poolSize = size;
+    d->trimParked(size);
+    emit poolSizeChanged();
+}
+
+QString FittingGridView::aspectRatioRole() const
+{
+    Q_D(const FittingGridView);
+    return d->aspectRatioRole;
+}
+
+void FittingGridView::setAspectRatioRole(const QString &role)
+{
+    Q_D(FittingGridView);
+    if (d->aspectRatioRole == role)
+        return;
+
+    d->aspectRatioRole = role;
+    d->aspectsChanged();
+    emit aspectRatioRoleChanged();
+}
+
+QString FittingGridView::widthRole() const
+{
+    Q_D(const FittingGridView);
+    return d->widthRole;
+}
+
+void FittingGridView::setWidthRole(const QString &role)
+{
+    Q_D(FittingGridView);
+    if (d->widthRole == role)
+        return;
+
+    d->widthRole = role;
+    d->aspectsChanged();
+    emit widthRoleChanged();
+}
+
+QString FittingGridView::heightRole() const
+{
+    Q_D(const FittingGridView);
+    return d->heightRole;
+}
+
+void FittingGridView::setHeightRole(const QString &role)
+{
+    Q_D(FittingGridView);
+    if (d->heightRole == role)
+        return;
+
+    d->heightRole = role;
+    d->aspectsChanged();
+    emit heightRoleChanged();
+}
+
+QString FittingGridView::sourceRole() const
+{
+    Q_D(const FittingGridView);
+    return d->sourceRole;
+}
+
+void FittingGridView::setSourceRole(const QString &role)
+{
+    Q_D(FittingGridView);
+    if (d->sourceRole == role)
+        return;
+
+    d->sourceRole = role;
+    d->aspectsChanged();
+    emit sourceRoleChanged();
+}
+
 void FittingGridView::classBegin()
 {
     QQuickItem::classBegin();
@@ -350,9 +677,26 @@ void FittingGridView::componentComplete()
     d->updateCurrent(d->currentIndex);
 }
 
+FittingGridViewStats *FittingGridView::stats()
+{
+    Q_D(FittingGridView);
+    if (!d->stats) {
+        d->stats = new FittingGridViewStats(this);
+        d->stats->m_view = d;
+        d->stats->reset();
+    }
+    return d->stats;
+}
+
+FittingGridViewAttached *FittingGridView::qmlAttachedProperties(QObject *object)
+{
+    return new FittingGridViewAttached(object);
+}
+
 void FittingGridView::updatePolish()
 {
     Q_D(FittingGridView);
+    TRACE("updatePolish");
     d->layout();
 }
 
@@ -376,60 +720,84 @@ class LayoutRow
 {
 public:
     FittingGridViewPrivate *view;
+    // Position of this row in view->rows
+    int index;
     int first;
     int last;
+    // Set for rows laid out upward from the rows after them, which must keep ending where the
+    // next row starts. updateRow doesn't add or remove items from these until first changes.
+    bool pinned;
 
-    double displayY;
-
-    LayoutRow(FittingGridViewPrivate *v);
+    LayoutRow(FittingGridViewPrivate *v, int index);
 
     bool isEmpty() const { return first < 0 || last < 0; }
     int count() const { return isEmpty() ? 0 : (last - first + 1); }
     bool isPresentable() { return !isEmpty() && !itemsLoading(); }
+    // Whether the row has been laid out since it last changed
+    bool isLaidOut() const { return m_layoutHeight; }
 
     double aspect();
     double layoutHeight();
     double displayHeight();
     int itemsLoading();
 
-    double calculateHeight(int count, double width, double aspect);
-
     // Update the row by setting the first index if applicable, and adding or
     // removing items from the end to meet layout requirements.
     bool updateRow(int first, int maxLast);
 
+    // Set the row from a layout that was already calculated, with all items known
+    void setLayout(int first, int last, double aspect);
+
     void dataChanged();
     void layoutChanged();
     void displayChanged();
 
+    // Whether the items of the row were all positioned for these inputs, and haven't changed since
+    bool isApplied(double y, double displayWidth) const
+    {
+        return m_applied && m_appliedY == y && m_appliedWidth == displayWidth && m_appliedHeight == m_displayHeight;
+    }
+    void setApplied(double y, double displayWidth)
+    {
+        m_applied = true;
+        m_appliedY = y;
+        m_appliedWidth = displayWidth;
+        m_appliedHeight = m_displayHeight;
+    }
+    void invalidateApplied() { m_applied = false; }
+
 private:
     double m_aspect;
     double m_layoutHeight;
     double m_displayHeight;
     int m_itemsLoading;
+
+    bool m_applied;
+    double m_appliedY;
+    double m_appliedWidth;
+    double m_appliedHeight;
 };
 
-LayoutRow::LayoutRow(FittingGridViewPrivate *v)
+LayoutRow::LayoutRow(FittingGridViewPrivate *v, int i)
     : view(v)
+    , index(i)
     , first(-1)
     , last(-1)
-    , displayY(-1)
+    , pinned(false)
     , m_aspect(0)
     , m_layoutHeight(0)
     , m_displayHeight(0)
     , m_itemsLoading(-1)
+    , m_applied(false)
+    , m_appliedY(0)
+    , m_appliedWidth(0)
+    , m_appliedHeight(0)
 {
 }
 
-double LayoutRow::calculateHeight(int count, double width, double aspect)
-{
-    if (!aspect || !count)
-        return 0;
-    return qRound((width - ((count - 1) * view->spacing)) / aspect);
-}
-
 bool LayoutRow::updateRow(int newFirst, int maxLast)
 {
+    TRACE_INDEX("updateRow", newFirst);
     bool added = false;
     bool removed = false;
 
@@ -438,6 +806,7 @@ bool LayoutRow::updateRow(int newFirst, int maxLast)
 
     if (first != newFirst) {
         first = last = newFirst;
+        pinned = false;
         dataChanged();
 
         added = true;
@@ -447,7 +816,7 @@ bool LayoutRow::updateRow(int newFirst, int maxLast)
     } else if (m_layoutHeight) {
         // Layout is cached, no changes to data are possible or necessary
         return false;
-    } else if (itemsLoading()) {
+    } else if (!pinned && itemsLoading()) {
         // Truncate at the first not-loaded item and refill; this is an easy way to
         // ensure that we fill up with the right number of sequential loaded items.
         // The normal remove-from-end logic wouldn't work, because it'd take all loading
@@ -461,39 +830,65 @@ bool LayoutRow::updateRow(int newFirst, int maxLast)
         }
     }
 
-    while (last < maxLast
-           && (!aspect() || layoutHeight() > view->maximumHeight)
-           && (!itemsLoading() || count() < view->maximumLoadingRowItems()))
-    {
-        // Add an item to the end
-        double newAspect = aspect() + view->indexAspectRatio(last + 1);
-        last++;
+    if (pinned) {
+        if (aspect())
+            layoutHeight();
+        return false;
+    }
+
+    const LayoutParameters params = view->layoutParameters();
+    auto aspectOf = [this](int i) { return view->indexAspectRatio(i); };
+
+    if (params.optimal) {
+        // Falls back to filling greedily while any items in the window are still loading
+        int optimalLast = LayoutEngine::optimalRowLast(params, first, maxLast, aspectOf);
+        if (optimalLast >= 0) {
+            bool changed = (optimalLast != last);
+            last = optimalLast;
+            dataChanged();
+            layoutHeight();
+            return changed || added;
+        }
+    }
+
+    int newLast = last;
+    double newAspect = aspect();
+    int loading = itemsLoading();
+
+    if (LayoutEngine::extendRow(params, first, maxLast, &newLast, &newAspect, &loading, aspectOf)) {
+        last = newLast;
         dataChanged();
         m_aspect = newAspect;
+        m_itemsLoading = loading;
 
         added = true;
     }
 
-    while (!added && last > first) {
-        // Calculate the layout height without the last item
-        double newAspect = aspect() - view->indexAspectRatio(last);
-        double newLayoutHeight = calculateHeight(count() - 1, view->layoutWidth(), newAspect);
-        if (newLayoutHeight > view->maximumHeight) {
-            // Do not remove any more items
-            break;
-        }
-
-        last--;
+    if (!added && LayoutEngine::shrinkRow(params, first, &newLast, &newAspect, aspectOf)) {
+        last = newLast;
         dataChanged();
         m_aspect = newAspect;
-        m_layoutHeight = newLayoutHeight;
 
         removed = true;
     }
 
+    // Caching the height marks the layout of this row as done until something changes
+    if (aspect())
+        layoutHeight();
+
     return added || removed;
 }
 
+void LayoutRow::setLayout(int newFirst, int newLast, double aspect)
+{
+    first = newFirst;
+    last = newLast;
+    pinned = false;
+    dataChanged();
+    m_aspect = aspect;
+    m_itemsLoading = 0;
+}
+
 double LayoutRow::aspect()
 {
     if (!m_aspect) {
@@ -506,7 +901,7 @@ double LayoutRow::aspect()
 double LayoutRow::layoutHeight()
 {
     if (!m_layoutHeight)
-        m_layoutHeight = calculateHeight(count(), view->layoutWidth(), aspect());
+        m_layoutHeight = LayoutEngine::rowHeight(view->spacing, count(), view->layoutWidth(), aspect());
     return m_layoutHeight;
 }
 
@@ -514,7 +909,7 @@ double LayoutRow::displayHeight()
 {
     if (!m_displayHeight) {
         if (isPresentable())
-            m_displayHeight = calculateHeight(count(), view->displayWidth, aspect());
+            m_displayHeight = LayoutEngine::rowHeight(view->spacing, count(), view->displayWidth, aspect());
         else
             m_displayHeight = view->maximumHeight;
     }
@@ -549,6 +944,8 @@ void LayoutRow::layoutChanged()
 void LayoutRow::displayChanged()
 {
     m_displayHeight = 0;
+    m_applied = false;
+    view->rowChanged(index);
 }
 
 }
@@ -568,7 +965,7 @@ bool FittingGridView::decrementCurrentRow()
 {
     Q_D(FittingGridView);
     int rowIndex = d->rowOf(currentIndex());
-    if (rowIndex < 0)
+    if (rowIndex < 0 || (!rowIndex && d->headIndex))
         return decrementCurrentIndex();
     else if (rowIndex)
         setCurrentIndex(d->rows[rowIndex - 1]->first);
@@ -577,6 +974,26 @@ bool FittingGridView::decrementCurrentRow()
     return true;
 }
 
+void FittingGridView::positionViewAtIndex(int index, PositionMode mode)
+{
+    Q_D(FittingGridView);
+    if (isComponentComplete())
+        d->positionViewAtIndex(index, mode);
+}
+
+int FittingGridView::indexAt(double x, double y) const
+{
+    Q_D(const FittingGridView);
+    return d->indexAt(x, y);
+}
+
+QQuickItem *FittingGridView::itemAt(double x, double y) const
+{
+    Q_D(const FittingGridView);
+    int index = d->indexAt(x, y);
+    return index >= 0 ? d->delegates.value(index) : 0;
+}
+
 FittingGridViewPrivate::FittingGridViewPrivate(FittingGridView *q)
     : QObject(q)
     , q_ptr(q)
@@ -584,19 +1001,47 @@ FittingGridViewPrivate::FittingGridViewPrivate(FittingGridView *q)
     , contentItem(0)
     , spacing(2)
     , cacheBuffer(0)
+    , adaptiveCacheBuffer(false)
+    , minimumCacheBuffer(0)
+    , maximumCacheBuffer(2000)
+    , lastContentY(0)
     , explicitLayoutWidth(0)
     , maximumHeight(300)
     , displayWidth(0)
     , headerSize(0)
+    , layoutMode(FittingGridView::Greedy)
+    , asynchronous(false)
+    , incubationBudget(4)
+    , inRequest(false)
+    , inIncubation(false)
+    , reuseItems(false)
+    , poolSize(20)
     , currentIndex(-1)
     , currentItem(0)
     , highlightItem(0)
+    , firstDirtyRow(0)
+    , headIndex(0)
+    , headHeight(0)
+    , hasPinnedRows(false)
     , cachedLayoutOnly(false)
+    , realizedMinY(0)
+    , realizedMaxY(-1)
+    , stats(0)
+    , layoutGeneration(0)
+    , layoutJobRevision(-1)
+    , layoutSnapshotRevision(-1)
+    , prefetchIndex(0)
+    , probeIndex(0)
 {
+    // Layouts are only useful in order, so there's never a reason to run more than one
+    layoutThread.setMaxThreadCount(1);
+    // Reading headers is mostly waiting for storage, in the order they're needed
+    probeThread.setMaxThreadCount(1);
 }
 
 FittingGridViewPrivate::~FittingGridViewPrivate()
 {
+    // This also cancels any background layout; layoutThread waits for it when destroyed
     clear();
     if (ownModel)
         delete model;
@@ -609,13 +1054,51 @@ double FittingGridViewPrivate::layoutWidth() const
     return displayWidth;
 }
 
+// Pixels to realize before and after the viewport
+void FittingGridViewPrivate::cacheMargins(double contentY, double *before, double *after) const
+{
+    if (!adaptiveCacheBuffer) {
+        *before = *after = cacheBuffer;
+        return;
+    }
+
+    // Positive when contentY is increasing. Without a velocity from the flickable, the
+    // direction is still known from how contentY moved since the last layout.
+    double velocity = flickable->property("verticalVelocity").toDouble();
+    if (!velocity && flickable->property("moving").toBool())
+        velocity = (contentY > lastContentY) ? 1 : ((contentY < lastContentY) ? -1 : 0);
+
+    int maximum = qMax(minimumCacheBuffer, maximumCacheBuffer);
+    if (!velocity) {
+        *before = *after = qBound(minimumCacheBuffer, cacheBuffer, maximum);
+        return;
+    }
+
+    double ahead = qBound(double(minimumCacheBuffer), cacheBuffer + qAbs(velocity) * prefetchTime, double(maximum));
+    *before = (velocity > 0) ? minimumCacheBuffer : ahead;
+    *after = (velocity > 0) ? ahead : minimumCacheBuffer;
+}
+
+LayoutParameters FittingGridViewPrivate::layoutParameters() const
+{
+    LayoutParameters p;
+    p.layoutWidth = layoutWidth();
+    p.displayWidth = displayWidth;
+    p.maximumHeight = maximumHeight;
+    p.spacing = spacing;
+    p.maximumLoadingRowItems = maximumLoadingRowItems();
+    p.optimal = (layoutMode == FittingGridView::Optimal);
+    return p;
+}
+
 void FittingGridViewPrivate::layoutChanged()
 {
     Q_Q(FittingGridView);
 
-    foreach (LayoutRow *row, rows) {
-        row->layoutChanged();
-        row->displayY = -1;
+    invalidateBackgroundLayout();
+    if (!anchorAtView()) {
+        foreach (LayoutRow *row, rows)
+            row->layoutChanged();
     }
     q->polish();
 }
@@ -624,49 +1107,237 @@ void FittingGridViewPrivate::displayChanged()
 {
     Q_Q(FittingGridView);
     displayWidth = contentItem ? contentItem->width() : 0;
-    foreach (LayoutRow *row, rows) {
-        row->displayChanged();
-        row->displayY = -1;
+    invalidateBackgroundLayout();
+    if (!anchorAtView()) {
+        foreach (LayoutRow *row, rows)
+            row->displayChanged();
     }
     q->polish();
 }
 
-int FittingGridViewPrivate::rowOf(int index)
+void FittingGridViewPrivate::aspectsChanged()
 {
-    for (int i = 0; i < rows.size(); i++) {
-        if (rows[i]->first <= index && rows[i]->last >= index)
-            return i;
-        else if (rows[i]->first > index)
-            break;
-    }
-    return -1;
+    Q_Q(FittingGridView);
+
+    // Any cached aspect might have come from a different source
+    cachedItemAspect.clear();
+    invalidateBackgroundLayout();
+    invalidateProbes();
+    probeRechecks.clear();
+    foreach (LayoutRow *row, rows)
+        row->dataChanged();
+    q->polish();
 }
 
-QQuickItem *FittingGridViewPrivate::createItem(int index, bool asynchronous)
+int FittingGridViewPrivate::rowOf(int index) const
 {
-    if (!contentItem)
-        return 0;
+    // Rows are always sorted by index, so binary search for the last row starting at or before index
+    int ri = rowStartingBefore(index);
+    if (ri < 0)
+        return -1;
 
-    QQuickItem *item = delegates.value(index);
-    if (item)
-        return item;
+    const LayoutRow *row = rows[ri];
+    if (row->isEmpty() || row->last < index)
+        return -1;
+    // row->index can be stale while model changes are applied
+    return ri;
+}
 
-    if (cachedLayoutOnly)
-        return 0;
+// Row with the highest first index that is at or before index, or -1
+int FittingGridViewPrivate::rowStartingBefore(int index) const
+{
+    auto it = std::upper_bound(rows.begin(), rows.end(), index,
+        [](int i, const LayoutRow *row) { return i < row->first; });
+    return int(it - rows.begin()) - 1;
+}
 
+double FittingGridViewPrivate::rowY(int row) const
+{
+    return headerSize + headHeight + rowOffsets.offset(row);
+}
+
+// First index of the row at this position if it continues from the rows before it
+int FittingGridViewPrivate::rowFirstIndex(int row) const
+{
+    return row ? (rows[row-1]->last + 1) : headIndex;
+}
+
+// Row indexed at content position y, or rows.size() past the end
+int FittingGridViewPrivate::rowAtY(double y) const
+{
+    return rowOffsets.rowAt(y - headerSize - headHeight);
+}
+
+void FittingGridViewPrivate::rowChanged(int row)
+{
+    if (row < firstDirtyRow)
+        firstDirtyRow = row;
+}
+
+// The data of items in row changed, which can also change the breaks of rows whose optimal
+// layout window includes it
+void FittingGridViewPrivate::rowDataChanged(int row)
+{
+    if (row < 0)
+        return;
+
+    int from = (layoutMode == FittingGridView::Optimal) ? qMax(0, row - LayoutEngine::windowRows + 1) : row;
+    for (int i = from; i <= row; i++)
+        rows[i]->dataChanged();
+}
+
+QQuickItem *FittingGridViewPrivate::createItem(int index, bool asynchronous)
+{
+    if (!contentItem)
+        return 0;
+
+    QQuickItem *item = delegates.value(index);
+    if (item)
+        return item;
+
+    if (cachedLayoutOnly)
+        return 0;
+
+    item = parkedDelegates.take(index);
+    if (item) {
+        parkOrder.removeOne(item);
+        delegates.insert(index, item);
+        STATS()->m_delegatesReused++;
+        // itemIndexes still has pooled items
+        if (FittingGridViewAttached *attached = qobject_cast<FittingGridViewAttached*>(qmlAttachedPropertiesObject<FittingGridView>(item, false)))
+            emit attached->reused();
+        DEBUG() << "unpark delegate:" << index << item;
+        return item;
+    }
+
+    TRACE_INDEX("createItem", index);
+    inRequest = true;
     QObject *object = model->object(index, asynchronous);
+    inRequest = false;
+
+    if (!object) {
+        // Still incubating; createdItem() will be called when it's ready
+        if (asynchronous)
+            incubatingIndexes.append(index);
+        return 0;
+    }
+
     item = qmlobject_cast<QQuickItem*>(object);
     if (!item) {
-        if (object)
-            model->release(object);
+        model->release(object);
         return 0;
     }
 
+    delegates.insert(index, item);
+    itemIndexes.insert(item, index);
     item->setParentItem(contentItem);
+    STATS()->m_delegatesCreated++;
     DEBUG() << "create delegate:" << index << item << item->implicitWidth() << item->implicitHeight();
     return item;
 }
 
+void FittingGridViewPrivate::releaseItem(int index, QQuickItem *item)
+{
+    TRACE_INDEX("releaseItem", index);
+
+    // The row has to position a new item if it comes back into view
+    int row = rowOf(index);
+    if (row >= 0)
+        rows[row]->invalidateApplied();
+
+    // Don't spend the decode threads on images that have scrolled away
+    if (FittingGridImage *image = qobject_cast<FittingGridImage*>(item))
+        image->cancel();
+
+    if (!reuseItems || poolSize <= 0) {
+        disposeItem(item);
+        return;
+    }
+
+    // Park the item, keeping the model's reference, so it can come back without being created again
+    item->setVisible(false);
+    parkedDelegates.insert(index, item);
+    parkOrder.append(item);
+    if (FittingGridViewAttached *attached = qobject_cast<FittingGridViewAttached*>(qmlAttachedPropertiesObject<FittingGridView>(item, false)))
+        emit attached->pooled();
+
+    trimParked(poolSize);
+}
+
+void FittingGridViewPrivate::trimParked(int size)
+{
+    while (parkOrder.size() > qMax(size, 0)) {
+        QQuickItem *item = parkOrder.takeFirst();
+        for (int i = 0; i < parkedDelegates.count(); i++) {
+            if (parkedDelegates.itemAt(i) == item) {
+                parkedDelegates.take(parkedDelegates.indexAt(i));
+                break;
+            }
+        }
+        disposeItem(item);
+    }
+}
+
+// Give an item that is no longer in delegates or parkedDelegates back to the model, for good.
+// This is the only place items leave the view.
+void FittingGridViewPrivate::disposeItem(QQuickItem *item)
+{
+    if (FittingGridImage *image = qobject_cast<FittingGridImage*>(item))
+        image->cancel();
+    itemIndexes.remove(item);
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 15, 0)
+    model->release(item, reuseItems ? QQmlInstanceModel::Reusable : QQmlInstanceModel::NotReusable);
+#else
+    model->release(item);
+#endif
+    STATS()->m_delegatesReleased++;
+}
+
+// Reset the per-pass counters, unless a pass is already running. Returns true if this started one.
+bool FittingGridViewPrivate::beginStatsPass()
+{
+    if (!statsEnabled() || statsPassTimer.isValid())
+        return false;
+
+    statsPassTimer.start();
+    stats->m_rowsRecomputed = 0;
+    stats->m_rowsWalked = 0;
+    stats->m_unpresentableRows = 0;
+    stats->m_layoutTime = 0;
+    stats->m_applyPendingChangesTime = 0;
+    stats->m_applyPositionsTime = 0;
+    return true;
+}
+
+void FittingGridViewPrivate::endStatsPass(bool began)
+{
+    if (!began)
+        return;
+
+    stats->m_layoutTime = statsPassTimer.nsecsElapsed() / 1e6;
+    statsPassTimer.invalidate();
+    updateStats();
+}
+
+void FittingGridViewPrivate::updateStats()
+{
+    stats->m_delegatesAlive = delegatesAlive();
+    stats->m_cachedAspects = cachedItemAspect.size();
+    stats->m_knownAspects = cachedItemAspect.knownCount();
+    emit stats->updated();
+}
+
+void FittingGridViewPrivate::itemReused(int index, QObject *object)
+{
+    Q_UNUSED(index);
+
+    // The model bound a pooled item to a new index
+    STATS()->m_delegatesReused++;
+    if (FittingGridViewAttached *attached = qobject_cast<FittingGridViewAttached*>(qmlAttachedPropertiesObject<FittingGridView>(object, false)))
+        emit attached->reused();
+}
+
 void FittingGridViewPrivate::createdItem(int index, QObject *object)
 {
     QQuickItem *item = qobject_cast<QQuickItem*>(object);
@@ -674,11 +1345,21 @@ void FittingGridViewPrivate::createdItem(int index, QObject *object)
         return;
 
     item->setVisible(false);
-    delegates.insert(index, item);
 
     QQuickItemPrivate::get(item)->addItemChangeListener(this,
                                                         QQuickItemPrivate::ImplicitWidth |
                                                         QQuickItemPrivate::ImplicitHeight);
+
+    if (!inRequest) {
+        // Asynchronous incubation finished. The model destroys the item after this unless
+        // it's referenced, so take the reference now and lay out its row again.
+        if (!delegates.value(index))
+            createItem(index);
+        sizeChangedIndexes.insert(index);
+        // completeIncubation lays out again itself
+        if (!inIncubation)
+            q->polish();
+    }
 }
 
 void FittingGridViewPrivate::initItem(int index, QObject *object)
@@ -708,23 +1389,6 @@ void FittingGridViewPrivate::modelUpdated(const QQmlChangeSet &changes, bool res
         q->polish();
 }
 
-template<typename T> T updateIndexMap(const T &map, int index, int delta,
-                                      std::function<void(typename T::const_iterator)> removeFunc = nullptr)
-{
-    T updated;
-    for (auto it = map.begin(); it != map.end(); it++) {
-        if (it.key() < index) {
-            updated.insert(it.key(), it.value());
-        } else if (delta < 0 && it.key() >= index && it.key() < (index - delta)) {
-            // Removed
-            if (removeFunc)
-                removeFunc(it);
-        } else
-            updated.insert(it.key() + delta, it.value());
-    }
-    return updated;
-}
-
 void FittingGridViewPrivate::layout()
 {
     double contentY = flickable->property("contentY").toDouble();
@@ -733,15 +1397,83 @@ void FittingGridViewPrivate::layout()
     if (layoutWidth() < 1 || displayWidth < 1 || viewportHeight < 1)
         return;
 
+    bool statsPass = beginStatsPass();
+    applyItemSizes();
     applyPendingChanges();
-    layoutItems(contentY - cacheBuffer, contentY + viewportHeight + cacheBuffer);
+
+    // Remember where the first visible row is shown, to keep it in place if rows above it
+    // change height during this layout
+    int anchorIndex = -1;
+    double anchorY = 0;
+    int anchorRow = rowAtY(contentY);
+    if ((anchorRow > 0 || headIndex) && anchorRow < rows.size()) {
+        anchorIndex = rows[anchorRow]->first;
+        anchorY = rowY(anchorRow);
+    }
+
+    double before, after;
+    cacheMargins(contentY, &before, &after);
+    before += viewportHeight * scrollHysteresis;
+    after += viewportHeight * scrollHysteresis;
+    lastContentY = contentY;
+
+    layoutItems(contentY - before, contentY + viewportHeight + after);
+    if (completeIncubation())
+        layoutItems(contentY - before, contentY + viewportHeight + after);
+
+    // Setting contentY interrupts a flick or drag in Flickable, so content above can only be
+    // compensated for while it's at rest
+    bool moving = flickable->property("moving").toBool();
+    if (anchorIndex >= 0 && !moving) {
+        anchorRow = rowStartingBefore(anchorIndex);
+        if (anchorRow >= 0 && rows[anchorRow]->first == anchorIndex && anchorRow < firstDirtyRow) {
+            double delta = rowY(anchorRow) - anchorY;
+            if (delta) {
+                DEBUG() << "layout: rows above" << anchorIndex << "moved by" << delta;
+                contentY += delta;
+                flickable->setProperty("contentY", contentY);
+            }
+        }
+    }
+
+    // Correct the estimated height above the rows while at rest, keeping the rows in view where
+    // they are on screen. Once the rows reach the start of the model there is nothing left to
+    // estimate, so the content is shifted right away even if that stops a flick.
+    bool headReached = !headIndex && headHeight;
+    if ((headIndex || headHeight || hasPinnedRows) && (!moving || headReached) && !rows.isEmpty()) {
+        int viewRow = qMin(rowAtY(contentY), rows.size() - 1);
+        int viewIndex = rows[viewRow]->first;
+        double viewY = rowY(viewRow);
+        if (reconcileHead()) {
+            layoutItems(contentY - before, contentY + viewportHeight + after);
+            viewRow = rowOf(viewIndex);
+            if (viewRow >= 0 && viewRow < firstDirtyRow && rowY(viewRow) != viewY) {
+                DEBUG() << "layout: rows before" << headIndex << "moved by" << rowY(viewRow) - viewY;
+                contentY += rowY(viewRow) - viewY;
+                flickable->setProperty("contentY", contentY);
+                layoutItems(contentY - before, contentY + viewportHeight + after);
+            }
+        }
+    }
+
+    if (!sourceRole.isEmpty()) {
+        int viewRow = rowAtY(contentY);
+        if (viewRow < rows.size())
+            updateProbes(rows[viewRow]->first);
+        else
+            updateProbes(rows.isEmpty() ? headIndex : rows.last()->last + 1);
+    }
+
+    updateBackgroundLayout();
     updateContentSize();
 
+    endStatsPass(statsPass);
+
     if (highlight && !highlightItem)
         createHighlight();
 
     if (highlightItem) {
-        highlightItem->setVisible(currentItem != 0);
+        highlightItem->setVisible(currentItem != 0 && (currentItem->isVisible() || rowOf(currentIndex) >= 0));
         if (currentItem) {
             highlightItem->setPosition(currentItem->position());
             highlightItem->setSize(QSizeF(currentItem->width(), currentItem->height()));
@@ -751,30 +1483,70 @@ void FittingGridViewPrivate::layout()
 
 void FittingGridViewPrivate::layoutItems(double minY, double maxY)
 {
-    double y = headerSize;
     int firstRow = -1, lastRow = -1, currentRow = -1;
 
     DEBUG() << "layout: position" << minY << "to" << maxY << "total" << model->count()
             << "layoutWidth" << layoutWidth() << "displayWidth" << displayWidth;
 
-    // Find existing rows within the range, and ensure positions of all existing rows up to there
+    // Far from the rows laid out so far, start again from the index estimated to be there
+    // instead of laying out every row in between. With a background layout, the row there and
+    // the height of the rows before it are exact.
+    const LayoutResult *result = currentLayout();
+    if (model->count()) {
+        double itemsPerRow, estimatedRowHeight;
+        estimateRowMetrics(&itemsPerRow, &estimatedRowHeight);
+        double jump = maximumJumpRows * estimatedRowHeight;
+        if (minY > rowY(rows.size()) + jump || (headIndex && minY < rowY(0) - jump)) {
+            if (result && result->rowCount()) {
+                int rri = result->rowAtOffset(minY - headerSize);
+                anchorRows(result->rowFirst[rri]);
+                headHeight = result->rowOffset[rri];
+            } else {
+                int row = estimatedRowHeight > 0 ? qMax(0, int((minY - headerSize) / estimatedRowHeight)) : 0;
+                anchorRows(qBound(0, qRound(row * itemsPerRow), model->count() - 1));
+            }
+        }
+    }
+    fillRowsBackward(minY);
+
+    // Rows before firstDirtyRow haven't changed since they were indexed, so start from the
+    // row that could first be within range instead of walking every row from the beginning.
+    int ri = qMin(qMin(firstDirtyRow, rows.size()), rowAtY(minY - maximumHeight));
+
+    if (currentIndex >= headIndex && ri > 0 && currentIndex <= rows[ri-1]->last) {
+        // The current row is before the walk, and only needs to be visited if it must be laid
+        // out again below.
+        currentRow = rowOf(currentIndex);
+        if (currentRow < 0 || !rows[currentRow]->isPresentable()) {
+            ri = qMax(currentRow, 0);
+            currentRow = -1;
+        }
+    }
+
+    double y = rowY(ri);
+
+    // Find existing rows within the range, and ensure positions of all existing rows up to there.
+    // The current row is only looked for within maximumJumpRows after the range.
     // XXX This means all rows below lastRow have completely inconsistent data
-    for (int ri = 0; lastRow < 0 || (currentRow < 0 && currentIndex >= 0); ri++) {
-        int rowFirst = ri ? (rows[ri-1]->last + 1) : 0;
+    for (; lastRow < 0 || (currentRow < 0 && currentIndex >= headIndex && ri <= lastRow + maximumJumpRows); ri++) {
+        int rowFirst = rowFirstIndex(ri);
         if (rowFirst >= model->count()) {
             if (lastRow < 0)
                 lastRow = ri - 1;
             while (rows.size() > ri)
                 delete rows.takeLast();
+            rowOffsets.resize(ri);
             break;
         }
 
         if (ri == rows.size()) {
-            LayoutRow *row = new LayoutRow(this);
+            LayoutRow *row = new LayoutRow(this, ri);
             rows.append(row);
+            rowOffsets.append(0);
         }
 
         LayoutRow *row = rows[ri];
+        STATS()->m_rowsWalked++;
 
         // Use maximumHeight when calculating if the current row is within minY to stay consistent
         // with cachedLayoutOnly and avoid flipping delegates
@@ -784,15 +1556,22 @@ void FittingGridViewPrivate::layoutItems(double minY, double maxY)
         // Do a cached-only layout for items we're not interested in displaying.
         cachedLayoutOnly = (firstRow < 0 || lastRow >= 0);
 
-        row->updateRow(rowFirst, model->count() - 1);
-        row->displayY = y;
+        // Rows that have to be laid out again are taken from the background layout if it has them
+        int rri = (row->isLaidOut() && row->first == rowFirst) ? -1 : adoptableRow(result, rowFirst);
+        if (rri >= 0) {
+            row->setLayout(rowFirst, result->rowLast(rri), result->rowAspect[rri]);
+        } else {
+            if (!row->isLaidOut())
+                STATS()->m_rowsRecomputed++;
+            row->updateRow(rowFirst, model->count() - 1);
+        }
 
         if (row->first <= currentIndex && row->last >= currentIndex) {
             // If the row was laid out with cachedLayoutOnly and isn't presentable,
             // reset cachedLayoutOnly and lay out again as if data changed, because
             // invalidation may not happen naturally when delegates are created via
             // applyPositions.
-            if (cachedLayoutOnly) {
+            if (cachedLayoutOnly && !row->isPresentable()) {
                 cachedLayoutOnly = false;
                 row->dataChanged();
                 row->updateRow(rowFirst, model->count() - 1);
@@ -804,6 +1583,7 @@ void FittingGridViewPrivate::layoutItems(double minY, double maxY)
         }
 
         if (!row->isPresentable()) {
+            STATS()->m_unpresentableRows++;
             if (!cachedLayoutOnly) {
                 DEBUG() << "layout: row" << ri << "for" << row->first << "to" << row->last << "still loading"
                         << row->itemsLoading();
@@ -817,58 +1597,709 @@ void FittingGridViewPrivate::layoutItems(double minY, double maxY)
         }
 
         // The height of an unpresentable row is maximumHeight.
-        y += row->displayHeight() + spacing;
+        rowOffsets.setValue(ri, row->displayHeight() + spacing);
+        y += rowOffsets.value(ri);
 
         if (y > maxY && lastRow < 0)
             lastRow = ri;
     }
 
+    // All rows up to here have been laid out and indexed
+    if (firstDirtyRow < ri)
+        firstDirtyRow = ri;
+
     cachedLayoutOnly = false;
 
     if (firstRow >= 0 && lastRow >= 0) {
+        QElapsedTimer positionsTimer;
+        if (statsEnabled())
+            positionsTimer.start();
+
         for (int i = firstRow; i >= 0 && i <= lastRow; i++) {
-            applyPositions(rows[i], rows[i]->displayY);
+            applyPositions(rows[i], rowY(i));
         }
 
         if (currentRow >= 0 && (currentRow < firstRow || currentRow > lastRow)) {
-            applyPositions(rows[currentRow], rows[currentRow]->displayY);
+            applyPositions(rows[currentRow], rowY(currentRow));
+        } else if (currentRow < 0 && currentItem && currentItem->isVisible()) {
+            // The current item is too far away to have a position yet
+            currentItem->setVisible(false);
         }
+        STATS()->m_applyPositionsTime += positionsTimer.nsecsElapsed() / 1e6;
+
+        // Nothing is missing before the first row or after the last row of the model
+        realizedMinY = (firstRow || headIndex) ? rowY(firstRow) : -std::numeric_limits<double>::infinity();
+        if (rows[lastRow]->last == model->count() - 1)
+            realizedMaxY = std::numeric_limits<double>::infinity();
+        else
+            realizedMaxY = rowY(lastRow) + rows[lastRow]->displayHeight();
 
         int firstIndex = rows[firstRow]->first;
         int lastIndex = rows[lastRow]->last;
         int firstCurrent = currentRow >= 0 ? rows[currentRow]->first : -1;
         int lastCurrent = currentRow >= 0 ? rows[currentRow]->last : -1;
-        for (auto it = delegates.begin(); it != delegates.end(); ) {
-            if ((it.key() < firstIndex || it.key() > lastIndex) &&
-                (it.key() < firstCurrent || it.key() > lastCurrent))
+        delegates.removeIf([this, firstIndex, lastIndex, firstCurrent, lastCurrent](int index, QQuickItem *item) {
+            if ((index < firstIndex || index > lastIndex) &&
+                (index < firstCurrent || index > lastCurrent))
             {
-                model->release(it.value());
-                it = delegates.erase(it);
-            } else
-                it++;
-        }
+                releaseItem(index, item);
+                return true;
+            }
+            return false;
+        });
     } else {
-        for (auto it = delegates.begin(); it != delegates.end(); it++)
-            model->release(it.value());
+        for (int i = 0; i < delegates.count(); i++)
+            releaseItem(delegates.indexAt(i), delegates.itemAt(i));
         delegates.clear();
+        realizedMinY = 0;
+        realizedMaxY = -1;
     }
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 15, 0)
+    // Destroy items that have been in the model's reuse pool for several layouts
+    if (reuseItems)
+        model->drainReusableItemsPool(maximumPoolTime);
+#endif
+}
+
+bool FittingGridViewPrivate::completeIncubation()
+{
+    Q_Q(FittingGridView);
+
+    QVector<int> requested;
+    requested.swap(incubatingIndexes);
+    if (requested.isEmpty() || incubationBudget <= 0)
+        return false;
+
+    QQmlEngine *engine = qmlEngine(q);
+    QQmlIncubationController *controller = engine ? engine->incubationController() : 0;
+    if (!controller)
+        return false;
+
+    // Advance incubation in small steps until this frame's budget is spent, so one heavy
+    // delegate can't run over it. Delegates that finish are taken in createdItem().
+    inIncubation = true;
+    controller->incubateFor(incubationBudget);
+    inIncubation = false;
+    bool remaining = controller->incubatingObjectCount() > 0;
+
+    // Only delegates this layout asked for are worth a second pass now; others that finished,
+    // from earlier layouts, are laid out on the next frame
+    bool completed = false;
+    foreach (int index, requested) {
+        if (delegates.value(index)) {
+            completed = true;
+            break;
+        }
+    }
+    bool finished = !sizeChangedIndexes.isEmpty();
+    applyItemSizes();
+
+    // Keep spending the budget on following frames. Polishing from within updatePolish would
+    // run again in the same frame, so this must be queued.
+    if (remaining || (finished && !completed))
+        QMetaObject::invokeMethod(q, "polish", Qt::QueuedConnection);
+    return completed;
+}
+
+void FittingGridViewPrivate::invalidateBackgroundLayout()
+{
+    layoutGeneration++;
+    if (layoutJob) {
+        layoutJob->cancelled.store(1);
+        layoutJob.clear();
+    }
+    layoutResult.clear();
+    layoutJobRevision = -1;
+    layoutSnapshot.clear();
+    prefetchIndex = 0;
+}
+
+bool FittingGridViewPrivate::prefetchAspects(int msecs)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    int count = model->count();
+    int laidOut = rows.isEmpty() ? -1 : rows.last()->last;
+    for (; prefetchIndex < count; prefetchIndex++) {
+        if (!(prefetchIndex % 64) && timer.elapsed() >= msecs)
+            return true;
+        if (cachedItemAspect.value(prefetchIndex) != AspectStore::Unknown)
+            continue;
+        // Rows laid out while this aspect was unknown are still loading
+        if (knownAspectRatio(prefetchIndex) != AspectStore::Unknown && prefetchIndex <= laidOut)
+            rowDataChanged(rowOf(prefetchIndex));
+    }
+    return false;
+}
+
+void FittingGridViewPrivate::updateBackgroundLayout()
+{
+    Q_Q(FittingGridView);
+
+    if (!hasModelAspects() && !hasCachedAspects())
+        return;
+
+    bool prefetching = prefetchAspects(prefetchBudget);
+
+    bool complete = !headIndex && !rows.isEmpty() && rows.last()->last == model->count() - 1 && firstDirtyRow >= rows.size();
+    bool running = false;
+    if (layoutJob) {
+        QMutexLocker locker(&layoutJob->mutex);
+        running = !layoutJob->result;
+    }
+    bool snapshotting = false;
+    if (!complete && !running && layoutJobRevision != cachedItemAspect.revision()) {
+        // The aspects for the job are copied a slice per frame. Aspects that change meanwhile
+        // make the snapshot a mix of old and new values, but rows are only taken from the
+        // result where the aspects they were laid out with are still current.
+        int count = model->count();
+        if (layoutSnapshot.isEmpty()) {
+            layoutSnapshot.reserve(count);
+            layoutSnapshotRevision = cachedItemAspect.revision();
+        }
+        int from = layoutSnapshot.size();
+        cachedItemAspect.appendTo(&layoutSnapshot, from, qMin(snapshotSlice, count - from));
+
+        if (layoutSnapshot.size() < count) {
+            snapshotting = true;
+        } else {
+            QSharedPointer<LayoutJob> job(new LayoutJob);
+            job->parameters = layoutParameters();
+            job->generation = layoutGeneration;
+            job->aspects.swap(layoutSnapshot);
+            layoutJob = job;
+            layoutJobRevision = layoutSnapshotRevision;
+            layoutThread.start(new LayoutTask(job, this, "backgroundLayoutFinished"));
+        }
+    }
+
+    // Polishing from within updatePolish would run again in the same frame, so this must be queued
+    if (prefetching || snapshotting)
+        QMetaObject::invokeMethod(q, "polish", Qt::QueuedConnection);
+}
+
+void FittingGridViewPrivate::invalidateProbes()
+{
+    if (probeJob) {
+        // Rechecks are still needed, at indexes from before any changes being applied
+        probeRechecks += probeJob->indexes.mid(0, probeJob->rechecks);
+        if (probeRechecks.size() > maximumProbeRechecks)
+            probeRechecks.remove(0, probeRechecks.size() - maximumProbeRechecks);
+        probeJob->cancelled.store(1);
+        probeJob.clear();
+    }
+    probeIndex = 0;
+}
+
+// Start reading image headers for the next batch of unknown aspects from fromIndex, unless a
+// batch is already being read. Model data is only accessible here, so paths are resolved first.
+void FittingGridViewPrivate::updateProbes(int fromIndex)
+{
+    Q_Q(FittingGridView);
+
+    if (probeJob)
+        return;
+
+    QSharedPointer<ProbeJob> job(new ProbeJob);
+    while (!probeRechecks.isEmpty() && job->indexes.size() < probeBatch) {
+        int index = probeRechecks.takeLast();
+        QString path = (index < model->count()) ? sourcePath(index) : QString();
+        if (path.isEmpty())
+            continue;
+        job->indexes.append(index);
+        job->paths.append(path);
+    }
+    job->rechecks = job->indexes.size();
+
+    int end = qMin(model->count(), fromIndex + probeLookahead);
+    int index = (probeIndex > fromIndex && probeIndex <= end) ? probeIndex : fromIndex;
+    for (; index < end && job->indexes.size() < probeBatch; index++) {
+        if (knownAspectRatio(index) != AspectStore::Unknown)
+            continue;
+
+        QString path = sourcePath(index);
+        if (path.isEmpty())
+            continue;
+        job->indexes.append(index);
+        job->paths.append(path);
+    }
+    // Images that can't be read are left to their delegates, and not read again from here
+    probeIndex = index;
+
+    if (job->indexes.isEmpty())
+        return;
+
+    DEBUG() << "layout: reading" << job->indexes.size() << "image headers from" << job->indexes.first();
+    probeJob = job;
+    probeThread.start(new ProbeTask(job, this, "probeFinished"));
+}
+
+// Local path of the image from sourceRole, or an empty string if it can't be read directly
+QString FittingGridViewPrivate::sourcePath(int index)
+{
+    Q_Q(FittingGridView);
+
+    QQmlContext *context = qmlContext(q);
+    QUrl url(modelString(model, index, sourceRole));
+    return QQmlFile::urlToLocalFileOrQrc(context ? context->resolvedUrl(url) : url);
+}
+
+void FittingGridViewPrivate::probeFinished()
+{
+    Q_Q(FittingGridView);
+
+    // Either a batch that was cancelled and replaced, or one that is still running
+    QSharedPointer<ProbeJob> job = probeJob;
+    if (!job)
+        return;
+    {
+        QMutexLocker locker(&job->mutex);
+        if (!job->finished)
+            return;
+    }
+    probeJob.clear();
+
+    bool useCache = aspectCache.isEnabled() && !aspectCacheKeyRole.isEmpty();
+    for (int i = 0; i < job->indexes.size(); i++) {
+        int index = job->indexes[i];
+        double v = job->aspects[i];
+        // A delegate may have measured the item in the meantime. Rechecked items only change
+        // if the image they now refer to has a different aspect.
+        double current = cachedItemAspect.value(index);
+        if (v <= 0 || (i < job->rechecks ? (current == v) : (current != AspectStore::Unknown)))
+            continue;
+
+        cachedItemAspect.setValue(index, v);
+        if (useCache)
+            aspectCache.setValue(aspectCacheKey(index), v);
+        rowDataChanged(rowOf(index));
+    }
+
+    // Lay out with the new aspects, and continue with the next batch
+    q->polish();
+}
+
+void FittingGridViewPrivate::contentYChanged()
+{
+    Q_Q(FittingGridView);
+
+    // Most scroll frames stay within the rows that were realized with some hysteresis by the
+    // last layout, and there is nothing to do for them.
+    double contentY = flickable->property("contentY").toDouble();
+    double before, after;
+    cacheMargins(contentY, &before, &after);
+    if (pendingChanges.isEmpty() && contentY - before >= realizedMinY
+        && contentY + flickable->height() + after <= realizedMaxY)
+        return;
+
+    q->polish();
+}
+
+void FittingGridViewPrivate::backgroundLayoutFinished()
+{
+    Q_Q(FittingGridView);
+
+    QSharedPointer<LayoutResult> result;
+    if (layoutJob) {
+        QMutexLocker locker(&layoutJob->mutex);
+        result = layoutJob->result;
+    }
+    // Either an older job that has since been replaced, or one that is still running
+    if (!result || result->generation != layoutGeneration)
+        return;
+
+    // Rows are taken from the result as the layout walks to them
+    DEBUG() << "layout: background layout finished with" << result->rowCount() << "rows";
+    layoutResult = result;
+    q->polish();
+}
+
+// The background layout, if it was made with the current layout parameters and model
+const LayoutResult *FittingGridViewPrivate::currentLayout() const
+{
+    if (!layoutResult || layoutResult->generation != layoutGeneration
+        || layoutResult->aspects.size() != model->count())
+        return 0;
+    return layoutResult.data();
+}
+
+// Row of the background layout starting at first, if the view can take it as it is: all of its
+// aspects were known, and haven't changed since. Returns -1 otherwise.
+int FittingGridViewPrivate::adoptableRow(const LayoutResult *result, int first) const
+{
+    int rri = result ? result->rowStartingAt(first) : -1;
+    if (rri < 0 || result->rowLoading[rri])
+        return -1;
+    for (int i = first, last = result->rowLast(rri); i <= last; i++) {
+        if (cachedItemAspect.value(i) != result->aspects[i])
+            return -1;
+    }
+    return rri;
+}
+
+// Whether headHeight is the exact height of the rows before headIndex
+bool FittingGridViewPrivate::headIsExact() const
+{
+    if (!headIndex)
+        return true;
+    const LayoutResult *result = currentLayout();
+    int rri = result ? result->rowStartingAt(headIndex) : -1;
+    return rri >= 0 && rri <= result->firstLoadingRow && headHeight == result->rowOffset[rri];
 }
 
 void FittingGridViewPrivate::updateContentSize()
 {
-    double avg;
     if (!rows.isEmpty()) {
-        if (rows.last()->last == model->count() - 1 && rows.last()->displayY >= 0) {
-            flickable->setProperty("contentHeight", rows.last()->displayY + rows.last()->displayHeight());
+        if (rows.last()->last == model->count() - 1 && firstDirtyRow >= rows.size()) {
+            setContentHeight(rowY(rows.size() - 1) + rows.last()->displayHeight(), headIsExact());
             return;
         }
 
-        avg = (rows.last()->last + 1) / rows.size();
+        // Rows the view hasn't laid out yet can be measured from the last background layout,
+        // as long as it partitioned the rows before them the same way
+        if (const LayoutResult *result = currentLayout()) {
+            int ri = qMin(firstDirtyRow, rows.size());
+            int rri = result->rowStartingAt(rowFirstIndex(ri));
+            if (rri >= 0) {
+                setContentHeight(rowY(ri) + result->totalHeight - result->rowOffset[rri] - spacing, headIsExact());
+                return;
+            }
+        }
+    }
+
+    setContentHeight(estimateContentHeight(), false);
+}
+
+// Extrapolate from the rows already laid out to the rest of the model
+double FittingGridViewPrivate::estimateContentHeight() const
+{
+    int laidOut = qMin(firstDirtyRow, rows.size());
+    int remaining = model->count() - rowFirstIndex(laidOut);
+    if (remaining <= 0)
+        return rowY(laidOut) - spacing;
+
+    double itemsPerRow, rowHeight;
+    estimateRowMetrics(&itemsPerRow, &rowHeight);
+    return rowY(laidOut) + ceil(remaining / itemsPerRow) * rowHeight - spacing;
+}
+
+// Mean items per row and mean row height with spacing of the rows already laid out, which the
+// row offset index keeps totals for. Before any rows are laid out, predict rows from the mean
+// of the aspects known so far as the layout would fill them.
+void FittingGridViewPrivate::estimateRowMetrics(double *itemsPerRow, double *rowHeight) const
+{
+    int laidOut = qMin(firstDirtyRow, rows.size());
+    if (laidOut) {
+        *itemsPerRow = double(rows[laidOut - 1]->last + 1 - headIndex) / laidOut;
+        *rowHeight = rowOffsets.offset(laidOut) / laidOut;
+    } else if (cachedItemAspect.knownCount()) {
+        double aspect = cachedItemAspect.knownMean();
+        int count = qMax(1, int(ceil((layoutWidth() + spacing) / (aspect * maximumHeight + spacing))));
+        *itemsPerRow = count;
+        *rowHeight = LayoutEngine::rowHeight(spacing, count, displayWidth, count * aspect) + spacing;
     } else {
-        avg = 1;
+        // Rows of items that aren't loaded yet
+        *itemsPerRow = maximumLoadingRowItems();
+        *rowHeight = maximumHeight + spacing;
+    }
+}
+
+double FittingGridViewPrivate::estimateHeadHeight() const
+{
+    if (!headIndex)
+        return 0;
+    double itemsPerRow, rowHeight;
+    estimateRowMetrics(&itemsPerRow, &rowHeight);
+    return ceil(headIndex / itemsPerRow) * rowHeight;
+}
+
+// Start the rows over from index, with the rows before it estimated, so that a far jump
+// doesn't lay out every row before it
+void FittingGridViewPrivate::anchorRows(int index)
+{
+    double itemsPerRow, rowHeight;
+    estimateRowMetrics(&itemsPerRow, &rowHeight);
+    DEBUG() << "layout: jumping from" << headIndex << "to" << index;
+
+    qDeleteAll(rows);
+    rows.clear();
+    rowOffsets.clear();
+    firstDirtyRow = 0;
+    hasPinnedRows = false;
+    headIndex = index;
+    headHeight = ceil(index / itemsPerRow) * rowHeight;
+}
+
+// Start the rows over from the first row in view when every row has to be laid out again, with
+// the old height of the rows above it as the estimate. Only the rows in range are laid out right
+// away, and the background layout provides the rest. Returns false if the view is at the top.
+bool FittingGridViewPrivate::anchorAtView()
+{
+    if (!flickable || rows.isEmpty())
+        return false;
+
+    int ri = qMin(rowAtY(flickable->property("contentY").toDouble()), rows.size() - 1);
+    if (!ri && !headIndex)
+        return false;
+
+    double height = rowY(ri) - headerSize;
+    anchorRows(rows[ri]->first);
+    headHeight = height;
+    return true;
+}
+
+// Lay out rows upward from the first row until it starts above minY. Each ends where the row
+// after it starts and takes as many items before that as a row would, so these can break
+// differently than rows laid out from the beginning of the model.
+void FittingGridViewPrivate::fillRowsBackward(double minY)
+{
+    if (!headIndex || rowY(0) <= minY)
+        return;
+
+    const LayoutParameters params = layoutParameters();
+    auto aspectOf = [this](int i) { return indexAspectRatio(i); };
+    // While the height before headIndex is exact, rows of the background layout are taken as
+    // they are, and keep it exact
+    const LayoutResult *result = currentLayout();
+    int rri = headIsExact() ? result->rowStartingAt(headIndex) : -1;
+    int added = 0;
+    while (headIndex > 0 && rowY(0) > minY) {
+        LayoutRow *row = new LayoutRow(this, 0);
+        if (rri > 0 && adoptableRow(result, result->rowFirst[rri - 1]) >= 0) {
+            rri--;
+            row->setLayout(result->rowFirst[rri], result->rowLast(rri), result->rowAspect[rri]);
+        } else {
+            rri = -1;
+            int last = headIndex - 1;
+            int first = last;
+            double aspect = aspectOf(first);
+            int loading = aspect ? 0 : 1;
+            LayoutEngine::extendRowBackward(params, 0, last, &first, &aspect, &loading, aspectOf);
+
+            row->first = first;
+            row->last = last;
+            row->pinned = true;
+            hasPinnedRows = true;
+            row->updateRow(first, model->count() - 1);
+            STATS()->m_rowsRecomputed++;
+        }
+        rows.prepend(row);
+        rowOffsets.prepend(row->displayHeight() + spacing);
+        headHeight -= rowOffsets.value(0);
+        headIndex = row->first;
+        added++;
+    }
+
+    for (int ri = 0; ri < rows.size(); ri++)
+        rows[ri]->index = ri;
+    firstDirtyRow = qMin(firstDirtyRow, rows.size() - added) + added;
+}
+
+// Replace the estimated height before headIndex with a new estimate, or with the exact height
+// from a background layout once there is one. Rows that don't start where a row of the layout
+// does are started over from the row containing headIndex. Returns true if anything changed.
+bool FittingGridViewPrivate::reconcileHead()
+{
+    const LayoutResult *result = currentLayout();
+    if (headIndex && result && result->rowContaining(headIndex) <= result->firstLoadingRow) {
+        if (headIsExact())
+            return false;
+        int rri = result->rowStartingAt(headIndex);
+        if (rri < 0) {
+            rri = result->rowContaining(headIndex);
+            DEBUG() << "layout: starting rows from" << headIndex << "over at" << result->rowFirst[rri];
+            anchorRows(result->rowFirst[rri]);
+        }
+        headHeight = result->rowOffset[rri];
+        return true;
+    }
+
+    double height = estimateHeadHeight();
+    bool changed = height != headHeight;
+    headHeight = height;
+    if (!headIndex && reflowPinnedRows())
+        changed = true;
+    return changed;
+}
+
+// Lay out the rows that were filled upward again from the start of the model, once all of their
+// aspects are known, so that row breaks are the same as if the rows had been laid out from the
+// top. Returns true if the rows were reflowed.
+bool FittingGridViewPrivate::reflowPinnedRows()
+{
+    if (!hasPinnedRows)
+        return false;
+
+    int lastPinned = -1;
+    for (int ri = 0; ri < rows.size(); ri++) {
+        if (!rows[ri]->pinned)
+            continue;
+        if (rows[ri]->itemsLoading())
+            return false;
+        lastPinned = ri;
+    }
+    hasPinnedRows = false;
+    if (lastPinned < 0)
+        return false;
+
+    DEBUG() << "layout: reflowing" << lastPinned + 1 << "rows laid out upward";
+    for (int ri = 0; ri <= lastPinned; ri++) {
+        rows[ri]->pinned = false;
+        rows[ri]->dataChanged();
+    }
+    reflowChanges(QVector<int>() << 0);
+    return true;
+}
+
+// Content position and display height of the row containing index. This is exact for rows that
+// are laid out or covered by the background layout after them, and estimated otherwise.
+double FittingGridViewPrivate::indexY(int index, double *height)
+{
+    int ri = rowOf(index);
+    if (ri >= 0 && ri < firstDirtyRow) {
+        *height = rows[ri]->displayHeight();
+        return rowY(ri);
+    }
+
+    int laidOut = qMin(firstDirtyRow, rows.size());
+    int nextIndex = rowFirstIndex(laidOut);
+    const LayoutResult *result = currentLayout();
+    if (result && index < headIndex && headIsExact()) {
+        int row = result->rowContaining(index);
+        *height = result->rowHeight[row];
+        return headerSize + result->rowOffset[row];
+    }
+    if (result && index >= nextIndex) {
+        int rri = result->rowStartingAt(nextIndex);
+        if (rri >= 0) {
+            int row = result->rowContaining(index);
+            *height = result->rowHeight[row];
+            return rowY(laidOut) + result->rowOffset[row] - result->rowOffset[rri];
+        }
+    }
+
+    double itemsPerRow, rowHeight;
+    estimateRowMetrics(&itemsPerRow, &rowHeight);
+    *height = rowHeight - spacing;
+    if (index < headIndex)
+        return rowY(0) - ceil((headIndex - index) / itemsPerRow) * rowHeight;
+    return rowY(laidOut) + floor((index - nextIndex) / itemsPerRow) * rowHeight;
+}
+
+// Lay out the rows around index, starting over there if it's far from the rows laid out so far,
+// and scroll to it. The landing is exact unless the row still isn't laid out after a few passes.
+void FittingGridViewPrivate::positionViewAtIndex(int index, FittingGridView::PositionMode mode)
+{
+    Q_Q(FittingGridView);
+    bool statsPass = beginStatsPass();
+    applyPendingChanges();
+    if (!flickable || index < 0 || index >= model->count() || layoutWidth() < 1 || displayWidth < 1) {
+        endStatsPass(statsPass);
+        return;
     }
 
-    flickable->setProperty("contentHeight", (model->count() / avg) * maximumHeight);
+    TRACE_INDEX("positionViewAtIndex", index);
+    double viewportHeight = flickable->height();
+    double contentY = flickable->property("contentY").toDouble();
+    double y = 0, height = 0;
+
+    for (int pass = 0; pass < maximumSeekPasses; pass++) {
+        int ri = rowOf(index);
+        if (ri >= 0 && ri < firstDirtyRow)
+            break;
+
+        if (!pass && !currentLayout()) {
+            double itemsPerRow, rowHeight;
+            estimateRowMetrics(&itemsPerRow, &rowHeight);
+            int nextIndex = rowFirstIndex(qMin(firstDirtyRow, rows.size()));
+            if ((index - nextIndex) / itemsPerRow > maximumJumpRows
+                || (headIndex - index) / itemsPerRow > maximumJumpRows)
+                anchorRows(index);
+        }
+
+        y = indexY(index, &height);
+        layoutItems(y - viewportHeight, y + height + viewportHeight);
+    }
+    y = indexY(index, &height);
+
+    double target = contentY;
+    switch (mode) {
+    case FittingGridView::Beginning:
+        target = y;
+        break;
+    case FittingGridView::Center:
+        target = y + (height - viewportHeight) / 2;
+        break;
+    case FittingGridView::End:
+        target = y + height - viewportHeight;
+        break;
+    case FittingGridView::Visible:
+        if (y + height > contentY && y < contentY + viewportHeight)
+            break;
+        // fall through
+    case FittingGridView::Contain:
+        if (y + height > target + viewportHeight)
+            target = y + height - viewportHeight;
+        if (y < target)
+            target = y;
+        break;
+    }
+
+    if (flickable->metaObject()->indexOfMethod("cancelFlick()") >= 0)
+        QMetaObject::invokeMethod(flickable, "cancelFlick");
+    updateContentSize();
+    double contentHeight = flickable->property("contentHeight").toDouble();
+    target = qBound(0.0, target, qMax(contentHeight - viewportHeight, 0.0));
+    DEBUG() << "layout: positioning at" << index << "y" << y << "contentY" << target;
+    if (target != contentY)
+        flickable->setProperty("contentY", target);
+    q->polish();
+    endStatsPass(statsPass);
+}
+
+int FittingGridViewPrivate::indexAt(double x, double y) const
+{
+    int ri = rowAtY(y);
+    if (ri >= qMin(firstDirtyRow, rows.size()) || y < rowY(ri))
+        return -1;
+    LayoutRow *row = rows[ri];
+    if (!row->isPresentable() || y >= rowY(ri) + row->displayHeight())
+        return -1;
+
+    // The same widths as applyPositions
+    double left = 0;
+    double availableWidth = displayWidth - ((row->count() - 1) * spacing);
+    double rAspect = row->aspect();
+    for (int index = row->first; index <= row->last && x >= left; index++) {
+        double aspect = cachedItemAspect.value(index);
+        double width = qRound(availableWidth / (rAspect / aspect));
+        if (x < left + width)
+            return index;
+
+        availableWidth -= width;
+        rAspect -= aspect;
+        left += width + spacing;
+    }
+    return -1;
+}
+
+void FittingGridViewPrivate::setContentHeight(double height, bool exact)
+{
+    Q_Q(FittingGridView);
+
+    // Estimates change as rows are laid out; while scrolling, approach a new estimate over a few
+    // frames instead of jumping the scrollbar.
+    double current = flickable->property("contentHeight").toDouble();
+    if (!exact && current > 0 && qAbs(height - current) > 1 && flickable->property("moving").toBool()) {
+        double contentY = flickable->property("contentY").toDouble();
+        height = qMax(current + (height - current) * estimateSmoothing, contentY + flickable->height());
+        QMetaObject::invokeMethod(q, "polish", Qt::QueuedConnection);
+    }
+
+    if (height != current)
+        flickable->setProperty("contentHeight", height);
 }
 
 void FittingGridViewPrivate::updateCurrent(int index)
@@ -886,10 +2317,12 @@ void FittingGridViewPrivate::updateCurrent(int index)
         }
     } else {
         currentItem = createItem(currentIndex);
-        // Hold an extra reference to the current item
-        model->object(currentIndex);
-        if (oldItem && currentItem != oldItem)
-            model->release(oldItem);
+        // Hold an extra reference to the current item, unless it's the same item at a new index
+        if (!currentItem || currentItem != oldItem) {
+            model->object(currentIndex);
+            if (oldItem)
+                model->release(oldItem);
+        }
     }
 
     q->polish();
@@ -941,136 +2374,332 @@ int FittingGridViewPrivate::maximumLoadingRowItems() const
 
 double FittingGridViewPrivate::indexAspectRatio(int index)
 {
-    QMap<int,double>::iterator it = cachedItemAspect.find(index);
-    if (it != cachedItemAspect.end())
-        return it.value();
+    double v = knownAspectRatio(index);
+    if (v != AspectStore::Unknown)
+        return v;
 
-    QQuickItem *item = createItem(index);
+    bool useCache = aspectCache.isEnabled() && !aspectCacheKeyRole.isEmpty();
+    QQuickItem *item = createItem(index, asynchronous);
     if (item) {
         double w = item->implicitWidth();
         double h = item->implicitHeight();
-        double v = (w && h) ? (item->implicitWidth() / item->implicitHeight()) : 0;
-        cachedItemAspect.insert(index, v);
+        v = (w && h) ? (item->implicitWidth() / item->implicitHeight()) : 0;
+        cachedItemAspect.setValue(index, v);
+        if (useCache && v > 0)
+            aspectCache.setValue(aspectCacheKey(index), v);
         return v;
     } else
         return 0;
 }
 
+// Aspect ratio of index from any source other than a delegate, or AspectStore::Unknown
+double FittingGridViewPrivate::knownAspectRatio(int index)
+{
+    double v = cachedItemAspect.value(index);
+    if (v != AspectStore::Unknown)
+        return v;
+
+    if (hasModelAspects()) {
+        v = modelAspectRatio(index);
+        if (v > 0) {
+            cachedItemAspect.setValue(index, v);
+            return v;
+        }
+    }
+
+    if (aspectCache.isEnabled() && !aspectCacheKeyRole.isEmpty()) {
+        v = aspectCache.value(aspectCacheKey(index));
+        if (v > 0) {
+            cachedItemAspect.setValue(index, v);
+            return v;
+        }
+    }
+
+    return AspectStore::Unknown;
+}
+
+bool FittingGridViewPrivate::hasModelAspects() const
+{
+    return !aspectRatioRole.isEmpty() || (!widthRole.isEmpty() && !heightRole.isEmpty());
+}
+
+double FittingGridViewPrivate::modelAspectRatio(int index)
+{
+    if (!aspectRatioRole.isEmpty())
+        return qMax(modelValue(model, index, aspectRatioRole), 0.0);
+
+    double w = modelValue(model, index, widthRole);
+    double h = modelValue(model, index, heightRole);
+    return (w > 0 && h > 0) ? (w / h) : 0;
+}
+
+bool FittingGridViewPrivate::hasCachedAspects() const
+{
+    return aspectCache.count() && !aspectCacheKeyRole.isEmpty();
+}
+
+quint64 FittingGridViewPrivate::aspectCacheKey(int index)
+{
+    return AspectCache::key(modelString(model, index, aspectCacheKeyRole));
+}
+
 void FittingGridViewPrivate::updateItemSize(int index)
 {
-    Q_Q(FittingGridView);
+    cachedItemAspect.invalidate(index);
 
-    cachedItemAspect.remove(index);
-    foreach (LayoutRow *row, rows) {
-        if (row->first <= index && row->last >= index) {
-            row->dataChanged();
-            break;
-        } else if (row->first > index) {
-            break;
+    // A delegate's own size replaces a value from the cache, which might be out of date
+    QQuickItem *item = delegates.value(index);
+    if (item && !hasModelAspects() && aspectCache.isEnabled() && !aspectCacheKeyRole.isEmpty()) {
+        double w = item->implicitWidth();
+        double h = item->implicitHeight();
+        if (w && h) {
+            cachedItemAspect.setValue(index, w / h);
+            aspectCache.setValue(aspectCacheKey(index), w / h);
         }
     }
 
+    rowDataChanged(rowOf(index));
+}
+
+void FittingGridViewPrivate::itemSizeChanged(QQuickItem *item)
+{
+    Q_Q(FittingGridView);
+
+    auto it = itemIndexes.constFind(item);
+    int index = (it != itemIndexes.constEnd()) ? it.value() : -1;
+    // The current item is referenced separately, and can outlive its delegate
+    if (index < 0 && item == currentItem)
+        index = currentIndex;
+    if (index < 0)
+        return;
+
+    sizeChangedIndexes.insert(index);
     q->polish();
 }
 
+// Update aspects and rows for all items with size changes since the last layout, in one pass
+void FittingGridViewPrivate::applyItemSizes()
+{
+    if (sizeChangedIndexes.isEmpty())
+        return;
+
+    TRACE("applyItemSizes");
+    int count = model->count();
+    foreach (int index, sizeChangedIndexes) {
+        if (index < count)
+            updateItemSize(index);
+    }
+    sizeChangedIndexes.clear();
+}
+
+void FittingGridViewPrivate::rebuildItemIndexes()
+{
+    itemIndexes.clear();
+    itemIndexes.reserve(delegates.count() + parkedDelegates.count());
+    for (int i = 0; i < delegates.count(); i++)
+        itemIndexes.insert(delegates.itemAt(i), delegates.indexAt(i));
+    for (int i = 0; i < parkedDelegates.count(); i++)
+        itemIndexes.insert(parkedDelegates.itemAt(i), parkedDelegates.indexAt(i));
+}
+
 void FittingGridViewPrivate::applyPositions(LayoutRow *row, double y)
 {
+    // Nothing about the row has changed since all of its items were last positioned
+    if (row->isApplied(y, displayWidth))
+        return;
+
+    bool complete = true;
     if (!row->isPresentable()) {
         // Don't show anything in an unpresentable row
         for (int index = row->first; index <= row->last; index++) {
-            QQuickItem *item = createItem(index);
-            if (!item)
+            QQuickItem *item = createItem(index, asynchronous);
+            if (!item) {
+                complete = false;
                 continue;
+            }
 
-            item->setVisible(false);
+            if (item->isVisible())
+                item->setVisible(false);
             // Set Y to allow for approximate positioning of the current item
-            item->setY(y);
+            if (item->y() != y)
+                item->setY(y);
         }
-        return;
-    }
-
-    double x = 0;
-    double availableWidth = displayWidth - ((row->count() - 1) * spacing);
-    double rAspect = row->aspect();
-
-    for (int index = row->first; index <= row->last; index++) {
-        QQuickItem *item = createItem(index);
-        if (!item)
-            continue;
-
-        double aspect = indexAspectRatio(index);
+    } else {
+        double x = 0;
+        double availableWidth = displayWidth - ((row->count() - 1) * spacing);
+        double rAspect = row->aspect();
+        double height = row->displayHeight();
 
-        item->setPosition(QPointF(x, y));
-        item->setSize(QSizeF(qRound(availableWidth / (rAspect / aspect)), row->displayHeight()));
-        item->setVisible(true);
+        for (int index = row->first; index <= row->last; index++) {
+            QQuickItem *item = createItem(index, asynchronous);
+            if (!item) {
+                complete = false;
+                continue;
+            }
 
-        availableWidth -= item->width();
-        rAspect -= aspect;
-        x += item->width() + spacing;
+            double aspect = indexAspectRatio(index);
+            double width = qRound(availableWidth / (rAspect / aspect));
+
+            // Every write notifies anchors and bindings in the delegate, so only write what changed
+            QPointF position(x, y);
+            if (item->position() != position)
+                item->setPosition(position);
+            if (item->width() != width || item->height() != height)
+                item->setSize(QSizeF(width, height));
+            if (!item->isVisible())
+                item->setVisible(true);
+
+            availableWidth -= width;
+            rAspect -= aspect;
+            x += width + spacing;
+        }
     }
+
+    // Rows with items that aren't ready yet are applied again when they are
+    if (complete)
+        row->setApplied(y, displayWidth);
 }
 
 void FittingGridViewPrivate::applyPendingChanges()
 {
-    Q_Q(FittingGridView);
     if (pendingChanges.isEmpty())
         return;
 
+    bool statsPass = beginStatsPass();
+    QElapsedTimer timer;
+    if (statsEnabled())
+        timer.start();
+    applyModelChanges();
+    STATS()->m_applyPendingChangesTime += timer.nsecsElapsed() / 1e6;
+    endStatsPass(statsPass);
+}
+
+void FittingGridViewPrivate::applyModelChanges()
+{
+    Q_Q(FittingGridView);
+
+    TRACE("applyPendingChanges");
     DEBUG() << "layout: model changes:" << pendingChanges;
+    // Size changes are indexed from before these changes
+    applyItemSizes();
+
+    // Changes to data alone leave everything in place, and usually don't affect layout at all
+    if (pendingChanges.removes().isEmpty() && pendingChanges.inserts().isEmpty()) {
+        QVector<int> changed = applyDataChanges();
+        pendingChanges.clear();
+        if (!changed.isEmpty())
+            reflowChanges(changed);
+        return;
+    }
 
-    // Process changes in the data and update existing rows. It's okay if this process
-    // leaves gaps; they will be closed while recalculating row layouts
-    bool currentChanged = false;
-    int newCurrentIndex = currentIndex;
-    foreach (const QQmlChangeSet::Change &remove, pendingChanges.removes()) {
-        // Delete all rows after the removed index; recalculation is relatively cheap
-        // and would almost always happen anyway.
-        while (!rows.isEmpty()) {
-            if (rows.last()->last < remove.index)
-                break;
-            delete rows.takeLast();
-        }
+    invalidateBackgroundLayout();
+    invalidateProbes();
 
-        cachedItemAspect = updateIndexMap(cachedItemAspect, remove.index, -remove.count);
-        delegates = updateIndexMap(delegates, remove.index, -remove.count,
-            // Explicit std::function construction necessary for gcc 4.6.4, for reasons unknown
-            std::function<void(QMap<int,QQuickItem*>::const_iterator)>(
-                [this](decltype(delegates.constBegin()) it) {
-                    model->release(it.value());
-                }
-            )
-        );
-
-        if (newCurrentIndex >= remove.index) {
-            if (newCurrentIndex < remove.end())
-                newCurrentIndex = qMin(remove.index, model->count() - 1);
-            else
-                newCurrentIndex -= remove.count;
-            currentChanged  = true;
+    // Map everything through the whole batch of changes in one pass: existing rows are shifted,
+    // and clipped or extended where they contain changes, and the places where changes happened
+    // (in final indexes) are laid out again below.
+    IndexRemap remap(pendingChanges);
+    QList<LayoutRow*> oldRows = rows;
+    rows.clear();
+    foreach (LayoutRow *row, oldRows) {
+        bool firstRemoved, lastRemoved;
+        int first = remap.afterRemoves(row->first, &firstRemoved);
+        int last = remap.afterRemoves(row->last, &lastRemoved);
+        // The end of the row was removed, up to the item before it
+        if (lastRemoved)
+            last--;
+        if (last < first) {
+            delete row;
+            continue;
+        }
+        bool changed = firstRemoved || lastRemoved || (last - first != row->last - row->first);
+
+        // Items inserted at the start of a row come before it, and anywhere else within it
+        // are added to the row. Rows that only shifted, including past moves, stay laid out.
+        int span = last - first;
+        first = remap.afterInserts(first);
+        last = remap.afterInserts(last);
+        changed = changed || (last - first != span);
+        row->first = first;
+        row->last = last;
+        if (changed) {
+            // Rows laid out upward can be refilled now that their items changed anyway
+            row->pinned = false;
+            row->dataChanged();
         }
+        rows.append(row);
+    }
+    for (int ri = 0; ri < rows.size(); ri++)
+        rows[ri]->index = ri;
+    if (headIndex)
+        headIndex = qMin(remap.afterInserts(remap.afterRemoves(headIndex)), qMax(model->count() - 1, 0));
+    QVector<int> changed = remap.changedPositions();
+
+    for (int i = 0; i < probeRechecks.size(); ) {
+        int index = remap.map(probeRechecks[i]);
+        if (index < 0) {
+            probeRechecks.remove(i);
+            continue;
+        }
+        probeRechecks[i++] = index;
     }
 
-    foreach (const QQmlChangeSet::Change &insert, pendingChanges.inserts()) {
-        foreach (LayoutRow *row, rows) {
-            // Row intersects with the insertion; all other rows are technically unchanged
-            if (row->first < insert.end() && row->last >= insert.index)
-                row->dataChanged();
-
-            // Layout will take care of fixing the row
-            if (row->first >= insert.index)
-                row->first += insert.count;
-            if (row->last >= insert.index)
-                row->last += insert.count;
+    // The aspect store's gap only moves forward through sorted removes, and then through
+    // sorted inserts, so applying them in order is linear in total. Aspects of moved items
+    // are restored at their destination, so they don't have to be measured again.
+    QVector<QPair<int,double> > movedAspects;
+    int removed = 0;
+    foreach (const QQmlChangeSet::Change &remove, pendingChanges.removes()) {
+        if (remove.isMove()) {
+            for (int i = 0; i < remove.count; i++) {
+                double v = cachedItemAspect.value(remove.index + i);
+                int index = remap.map(remove.index + removed + i);
+                if (v != AspectStore::Unknown && index >= 0)
+                    movedAspects.append(qMakePair(index, v));
+            }
         }
+        cachedItemAspect.removeRange(remove.index, remove.count);
+        removed += remove.count;
+    }
+    foreach (const QQmlChangeSet::Change &insert, pendingChanges.inserts())
+        cachedItemAspect.insertRange(insert.index, insert.count);
+    for (int i = 0; i < movedAspects.size(); i++)
+        cachedItemAspect.setValue(movedAspects[i].first, movedAspects[i].second);
+
+    // Rows that contained removed items were changed above, so they position their items again
+    auto map = [&remap](int index) { return remap.map(index); };
+    delegates.remap(map,
+        [this](QQuickItem *item) {
+            disposeItem(item);
+        }
+    );
+    parkedDelegates.remap(map,
+        [this](QQuickItem *item) {
+            parkOrder.removeOne(item);
+            disposeItem(item);
+        }
+    );
 
-        cachedItemAspect = updateIndexMap(cachedItemAspect, insert.index, insert.count);
-        delegates = updateIndexMap(delegates, insert.index, insert.count);
+    // The current item follows moves; if it's removed, the item taking its place is current
+    bool currentChanged = false;
+    int newCurrentIndex = currentIndex;
+    if (currentIndex >= 0) {
+        newCurrentIndex = remap.map(currentIndex);
+        currentChanged = (newCurrentIndex < 0);
+        if (newCurrentIndex < 0)
+            newCurrentIndex = qMin(remap.afterInserts(remap.afterRemoves(currentIndex)), model->count() - 1);
+        currentChanged = currentChanged || newCurrentIndex != currentIndex;
+    }
 
-        if (newCurrentIndex >= insert.index) {
-            newCurrentIndex += insert.count;
-            currentChanged = true;
-        }
+    rebuildItemIndexes();
+
+    // Data changes are indexed after the removes and inserts
+    QVector<int> dataChanged = applyDataChanges();
+    if (!dataChanged.isEmpty()) {
+        changed += dataChanged;
+        std::sort(changed.begin(), changed.end());
     }
+    reflowChanges(changed);
 
     pendingChanges.clear();
     if (currentChanged && q->isComponentComplete()) {
@@ -1081,15 +2710,161 @@ void FittingGridViewPrivate::applyPendingChanges()
     }
 }
 
+// Role changes only matter to layout when they change an aspect ratio. The change set doesn't
+// say which roles changed, so only items with a known aspect are checked: aspect roles and
+// aspect cache keys are read again and compared, and images from sourceRole are read again
+// on probeThread. Delegates report their own size changes. Returns the indexes with aspects
+// that changed here, in order.
+QVector<int> FittingGridViewPrivate::applyDataChanges()
+{
+    QVector<int> changed;
+    bool modelAspects = hasModelAspects();
+    bool cacheKeys = aspectCache.isEnabled() && !aspectCacheKeyRole.isEmpty();
+    if (!modelAspects && !cacheKeys && sourceRole.isEmpty())
+        return changed;
+
+    // Rechecks are queued in order and trimmed to the most recent once for the whole batch
+    bool recheck = !modelAspects && !sourceRole.isEmpty();
+    QSet<int> queued;
+    if (recheck) {
+        foreach (int index, probeRechecks)
+            queued.insert(index);
+    }
+
+    int count = model->count();
+    foreach (const QQmlChangeSet::Change &change, pendingChanges.changes()) {
+        for (int index = change.index; index < qMin(change.end(), count); index++) {
+            double old = cachedItemAspect.value(index);
+            if (old == AspectStore::Unknown)
+                continue;
+
+            if (recheck && !queued.contains(index)) {
+                queued.insert(index);
+                probeRechecks.append(index);
+            }
+            if (!modelAspects && !cacheKeys)
+                continue;
+
+            // Without a value from the model or cache, the aspect is measured from the delegate again
+            double v = modelAspects ? modelAspectRatio(index) : aspectCache.value(aspectCacheKey(index));
+            if (v == old)
+                continue;
+
+            if (v > 0)
+                cachedItemAspect.setValue(index, v);
+            else
+                cachedItemAspect.invalidate(index);
+            rowDataChanged(rowOf(index));
+            changed.append(index);
+        }
+    }
+
+    if (probeRechecks.size() > maximumProbeRechecks)
+        probeRechecks.remove(0, probeRechecks.size() - maximumProbeRechecks);
+
+    if (!changed.isEmpty()) {
+        DEBUG() << "layout: data changes affected" << changed.size() << "aspects";
+        invalidateBackgroundLayout();
+    }
+    return changed;
+}
+
+// Lay out rows from each change until their breaks line up with the shifted rows again, and
+// index rows and their offsets once for the whole batch. changed is in order.
+void FittingGridViewPrivate::reflowChanges(const QVector<int> &changed)
+{
+    // Only aspects that are already known are used, so this never creates delegates.
+    cachedLayoutOnly = true;
+    int reflowedTo = -1;
+    foreach (int index, changed) {
+        if (index < reflowedTo)
+            continue;
+        int ri = reflowRows(index);
+        reflowedTo = (ri < rows.size()) ? rows[ri]->first : model->count();
+    }
+
+    // Index rows and their offsets once for the whole batch. Rows after the first that isn't
+    // laid out, or doesn't continue from the row before it, are still dirty.
+    rowOffsets.clear();
+    firstDirtyRow = rows.size();
+    for (int ri = 0; ri < rows.size(); ri++) {
+        LayoutRow *row = rows[ri];
+        row->index = ri;
+        rowOffsets.append(row->displayHeight() + spacing);
+        if (firstDirtyRow == rows.size() && (!row->isLaidOut() || row->first != rowFirstIndex(ri)))
+            firstDirtyRow = ri;
+    }
+    cachedLayoutOnly = false;
+}
+
+// Lay out rows again from the row containing index until one starts at the same place as an
+// existing row after index that is laid out; the rows from there on are still valid. Returns
+// the position of that row, or where the reflow stopped.
+int FittingGridViewPrivate::reflowRows(int index)
+{
+    int ri = qMax(rowStartingBefore(index), 0);
+    if (layoutMode == FittingGridView::Optimal)
+        ri = qMax(0, ri - LayoutEngine::windowRows + 1);
+
+    int count = model->count();
+    for (int reflowed = 0; ri < rows.size(); ri++, reflowed++) {
+        int rowFirst = rowFirstIndex(ri);
+        if (rowFirst >= count) {
+            while (rows.size() > ri)
+                delete rows.takeLast();
+            break;
+        }
+
+        // Rows that are now entirely covered by the rows before them
+        while (ri + 1 < rows.size() && rows[ri+1]->first <= rowFirst)
+            delete rows.takeAt(ri);
+
+        LayoutRow *row = rows[ri];
+        if (rowFirst > index && row->first == rowFirst && row->isLaidOut())
+            break;
+        // The layout walk will continue from here
+        if (reflowed >= maximumReflowRows)
+            break;
+
+        if (row->first > rowFirst) {
+            row = new LayoutRow(this, ri);
+            rows.insert(ri, row);
+        } else if (row->first == rowFirst && rowFirst <= index) {
+            row->dataChanged();
+        }
+        row->updateRow(rowFirst, count - 1);
+        STATS()->m_rowsRecomputed++;
+    }
+
+    return ri;
+}
+
 void FittingGridViewPrivate::clear()
 {
+    aspectCache.save();
+    invalidateBackgroundLayout();
+    invalidateProbes();
+    probeRechecks.clear();
     qDeleteAll(rows);
     rows.clear();
+    rowOffsets.clear();
+    firstDirtyRow = 0;
+    headIndex = 0;
+    headHeight = 0;
+    hasPinnedRows = false;
+    realizedMinY = 0;
+    realizedMaxY = -1;
     pendingChanges.clear();
     cachedItemAspect.clear();
-    foreach (QQuickItem *item, delegates)
-        model->release(item);
+    for (int i = 0; i < delegates.count(); i++)
+        disposeItem(delegates.itemAt(i));
     delegates.clear();
+    for (int i = 0; i < parkedDelegates.count(); i++)
+        disposeItem(parkedDelegates.itemAt(i));
+    parkedDelegates.clear();
+    parkOrder.clear();
+    itemIndexes.clear();
+    sizeChangedIndexes.clear();
     if (currentItem) {
         model->release(currentItem);
         currentItem = 0;
@@ -1104,15 +2879,11 @@ void FittingGridViewPrivate::clear()
 
 void FittingGridViewPrivate::itemImplicitHeightChanged(QQuickItem *item)
 {
-    int index = model->indexOf(item, 0);
-    if (index >= 0)
-        updateItemSize(index);
+    itemSizeChanged(item);
 }
 
 void FittingGridViewPrivate::itemImplicitWidthChanged(QQuickItem *item)
 {
-    int index = model->indexOf(item, 0);
-    if (index >= 0)
-        updateItemSize(index);
+    itemSizeChanged(item);
 }
 
@@ -25,14 +25,51 @@
 #include <QQmlParserStatus>
 
 class FittingGridViewPrivate;
+class FittingGridViewStats;
+
+class FittingGridViewAttached : public QObject
+{
+    Q_OBJECT
+
+public:
+    FittingGridViewAttached(QObject *parent)
+        : QObject(parent)
+    {
+    }
+
+signals:
+    // The item was released and parked; see FittingGridView::reuseItems
+    void pooled();
+    // The item came back from being parked, or was bound to a new index by the model
+    void reused();
+};
 
 class FittingGridView : public QQuickItem
 {
     Q_OBJECT
     Q_DISABLE_COPY(FittingGridView)
     Q_INTERFACES(QQmlParserStatus)
+    Q_ENUMS(LayoutMode PositionMode)
     
 public:
+    enum LayoutMode {
+        // Fill each row in turn with as many items as fit within maximumHeight
+        Greedy,
+        // Choose row breaks to keep all rows close to maximumHeight
+        Optimal
+    };
+
+    // Where positionViewAtIndex places an item, as in ListView
+    enum PositionMode {
+        Beginning,
+        Center,
+        End,
+        // Only move if no part of the item is in view
+        Visible,
+        // Move as little as possible to show the whole item, or its top if it's taller than the view
+        Contain
+    };
+
     FittingGridView(QQuickItem *parent = 0);
     ~FittingGridView();
 
@@ -61,6 +98,10 @@ public:
     double maximumHeight() const;
     void setMaximumHeight(double maximumHeight);
 
+    Q_PROPERTY(LayoutMode layoutMode READ layoutMode WRITE setLayoutMode NOTIFY layoutModeChanged)
+    LayoutMode layoutMode() const;
+    void setLayoutMode(LayoutMode mode);
+
     Q_PROPERTY(int currentIndex READ currentIndex WRITE setCurrentIndex NOTIFY currentIndexChanged)
     int currentIndex() const;
     void setCurrentIndex(int currentIndex);
@@ -74,6 +115,12 @@ public:
     Q_INVOKABLE bool incrementCurrentIndex();
     Q_INVOKABLE bool decrementCurrentIndex();
 
+    // Scroll to an item without laying out the rows before it, if they aren't already
+    Q_INVOKABLE void positionViewAtIndex(int index, PositionMode mode);
+    // Item at a position in content coordinates, like ListView, among the rows that are laid out
+    Q_INVOKABLE int indexAt(double x, double y) const;
+    Q_INVOKABLE QQuickItem *itemAt(double x, double y) const;
+
     Q_PROPERTY(QQuickItem *currentItem READ currentItem NOTIFY currentItemChanged)
     QQuickItem *currentItem() const;
 
@@ -88,9 +135,80 @@ public:
     int cacheBuffer() const;
     void setCacheBuffer(int pixels);
 
+    // Instead of cacheBuffer on both sides, buffer further ahead in the direction of scrolling
+    // in proportion to its speed, and less behind, within the minimum and maximum buffers
+    Q_PROPERTY(bool adaptiveCacheBuffer READ adaptiveCacheBuffer WRITE setAdaptiveCacheBuffer NOTIFY adaptiveCacheBufferChanged)
+    bool adaptiveCacheBuffer() const;
+    void setAdaptiveCacheBuffer(bool adaptive);
+
+    Q_PROPERTY(int minimumCacheBuffer READ minimumCacheBuffer WRITE setMinimumCacheBuffer NOTIFY minimumCacheBufferChanged)
+    int minimumCacheBuffer() const;
+    void setMinimumCacheBuffer(int pixels);
+
+    Q_PROPERTY(int maximumCacheBuffer READ maximumCacheBuffer WRITE setMaximumCacheBuffer NOTIFY maximumCacheBufferChanged)
+    int maximumCacheBuffer() const;
+    void setMaximumCacheBuffer(int pixels);
+
+    Q_PROPERTY(QString aspectCacheFile READ aspectCacheFile WRITE setAspectCacheFile NOTIFY aspectCacheFileChanged)
+    QString aspectCacheFile() const;
+    void setAspectCacheFile(const QString &fileName);
+
+    Q_PROPERTY(QString aspectCacheKeyRole READ aspectCacheKeyRole WRITE setAspectCacheKeyRole NOTIFY aspectCacheKeyRoleChanged)
+    QString aspectCacheKeyRole() const;
+    void setAspectCacheKeyRole(const QString &role);
+
+    Q_INVOKABLE bool saveAspectCache();
+
+    // Write trace events recorded while FITTINGGRIDVIEW_TRACE is set to path
+    Q_INVOKABLE bool dumpTrace(const QString &path);
+
+    Q_PROPERTY(bool asynchronous READ asynchronous WRITE setAsynchronous NOTIFY asynchronousChanged)
+    bool asynchronous() const;
+    void setAsynchronous(bool asynchronous);
+
+    Q_PROPERTY(int incubationBudget READ incubationBudget WRITE setIncubationBudget NOTIFY incubationBudgetChanged)
+    int incubationBudget() const;
+    void setIncubationBudget(int msecs);
+
+    // Reuse delegates for other indexes, e.g. while scrolling forward. This needs Qt 5.15 or
+    // later, where released delegates go to the model as reusable and it rebinds them. Up to
+    // poolSize released delegates are also kept for a while, so items that come back into view
+    // at the same index aren't created again; with older Qt, that is all this does.
+    Q_PROPERTY(bool reuseItems READ reuseItems WRITE setReuseItems NOTIFY reuseItemsChanged)
+    bool reuseItems() const;
+    void setReuseItems(bool reuse);
+
+    Q_PROPERTY(int poolSize READ poolSize WRITE setPoolSize NOTIFY poolSizeChanged)
+    int poolSize() const;
+    void setPoolSize(int size);
+
+    Q_PROPERTY(QString aspectRatioRole READ aspectRatioRole WRITE setAspectRatioRole NOTIFY aspectRatioRoleChanged)
+    QString aspectRatioRole() const;
+    void setAspectRatioRole(const QString &role);
+
+    Q_PROPERTY(QString widthRole READ widthRole WRITE setWidthRole NOTIFY widthRoleChanged)
+    QString widthRole() const;
+    void setWidthRole(const QString &role);
+
+    Q_PROPERTY(QString heightRole READ heightRole WRITE setHeightRole NOTIFY heightRoleChanged)
+    QString heightRole() const;
+    void setHeightRole(const QString &role);
+
+    // Role with the URL of each item's image. When set, the sizes of local JPEG, PNG and WebP
+    // images are read from their headers ahead of the viewport, before delegates exist.
+    Q_PROPERTY(QString sourceRole READ sourceRole WRITE setSourceRole NOTIFY sourceRoleChanged)
+    QString sourceRole() const;
+    void setSourceRole(const QString &role);
+
+    // Created on first use; see FittingGridViewStats
+    Q_PROPERTY(FittingGridViewStats *stats READ stats CONSTANT)
+    FittingGridViewStats *stats();
+
     virtual void classBegin();
     virtual void componentComplete();
 
+    static FittingGridViewAttached *qmlAttachedProperties(QObject *object);
+
 signals:
     void modelChanged();
     void delegateChanged();
@@ -98,12 +216,26 @@ signals:
     void spacingChanged();
     void layoutWidthChanged();
     void maximumHeightChanged();
+    void layoutModeChanged();
     void currentIndexChanged();
     void currentItemChanged();
     void highlightChanged();
     void highlightItemChanged();
     void cacheBufferChanged();
+    void adaptiveCacheBufferChanged();
+    void minimumCacheBufferChanged();
+    void maximumCacheBufferChanged();
     void headerSizeChanged();
+    void aspectCacheFileChanged();
+    void aspectCacheKeyRoleChanged();
+    void asynchronousChanged();
+    void incubationBudgetChanged();
+    void reuseItemsChanged();
+    void poolSizeChanged();
+    void aspectRatioRoleChanged();
+    void widthRoleChanged();
+    void heightRoleChanged();
+    void sourceRoleChanged();
 
 public slots:
     void polish() { QQuickItem::polish(); }
@@ -118,5 +250,6 @@ private:
 };
 
 QML_DECLARE_TYPE(FittingGridView)
+QML_DECLARE_TYPEINFO(FittingGridView, QML_HAS_ATTACHED_PROPERTIES)
 
 #endif // FITTINGGRIDVIEW_H
@@ -0,0 +1,29 @@
+# Sources of the view itself, shared by the plugin and the benchmarks
+INCLUDEPATH += $$PWD
+
+SOURCES += \
+    $$PWD/fittinggridview.cpp \
+    $$PWD/fittinggridviewstats.cpp \
+    $$PWD/fittinggridimage.cpp \
+    $$PWD/aspectcache.cpp \
+    $$PWD/aspectstore.cpp \
+    $$PWD/delegatewindow.cpp \
+    $$PWD/imageheader.cpp \
+    $$PWD/indexremap.cpp \
+    $$PWD/layoutengine.cpp \
+    $$PWD/rowoffsetindex.cpp \
+    $$PWD/tracing.cpp
+
+HEADERS += \
+    $$PWD/fittinggridview.h \
+    $$PWD/fittinggridview_p.h \
+    $$PWD/fittinggridviewstats.h \
+    $$PWD/fittinggridimage.h \
+    $$PWD/aspectcache_p.h \
+    $$PWD/aspectstore_p.h \
+    $$PWD/delegatewindow_p.h \
+    $$PWD/imageheader_p.h \
+    $$PWD/indexremap_p.h \
+    $$PWD/layoutengine_p.h \
+    $$PWD/rowoffsetindex_p.h \
+    $$PWD/tracing_p.h
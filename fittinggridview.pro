@@ -7,14 +7,13 @@ TARGET = $$qtLibraryTarget($$TARGET)
 uri = FittingGridView
 
 # Input
+include(fittinggridview.pri)
+
 SOURCES += \
-    plugin.cpp \
-    fittinggridview.cpp
+    plugin.cpp
 
 HEADERS += \
-    plugin.h \
-    fittinggridview.h \
-    fittinggridview_p.h
+    plugin.h
 
 OTHER_FILES = qmldir
 
@@ -22,6 +22,17 @@
 #define FITTINGGRIDVIEW_P_H
 
 #include "fittinggridview.h"
+#include "fittinggridviewstats.h"
+#include "aspectcache_p.h"
+#include "aspectstore_p.h"
+#include "delegatewindow_p.h"
+#include "imageheader_p.h"
+#include "layoutengine_p.h"
+#include "rowoffsetindex_p.h"
+#include <QElapsedTimer>
+#include <QHash>
+#include <QSet>
+#include <QThreadPool>
 #include <QtQml/private/qqmldelegatemodel_p.h>
 #include <QtQml/private/qqmlguard_p.h>
 #include <QtQuick/private/qquickitemchangelistener_p.h>
@@ -49,10 +60,55 @@ public:
 
     int spacing;
     int cacheBuffer;
+    bool adaptiveCacheBuffer;
+    int minimumCacheBuffer;
+    int maximumCacheBuffer;
+    // contentY at the previous layout, for the direction of scrolling
+    double lastContentY;
     double explicitLayoutWidth;
     double maximumHeight;
     double displayWidth;
     double headerSize;
+    FittingGridView::LayoutMode layoutMode;
+
+    // Roles to read aspect ratios from the model, instead of measuring delegates
+    QString aspectRatioRole;
+    QString widthRole;
+    QString heightRole;
+
+    // Role with image URLs to read aspect ratios from image headers on probeThread, for
+    // indexes from the viewport onward. Only one batch is read at a time.
+    QString sourceRole;
+    QThreadPool probeThread;
+    QSharedPointer<ProbeJob> probeJob;
+    // Indexes up to here were read by earlier batches
+    int probeIndex;
+    // Indexes with data changes, to read again even though their aspect is known
+    QVector<int> probeRechecks;
+
+    // Aspect ratios saved from previous runs, keyed by the aspectCacheKeyRole of each item
+    AspectCache aspectCache;
+    QString aspectCacheKeyRole;
+
+    // Create delegates asynchronously, and finish incubating them for up to incubationBudget
+    // milliseconds per frame
+    bool asynchronous;
+    int incubationBudget;
+    // Indexes requested asynchronously during this layout which weren't ready yet
+    QVector<int> incubatingIndexes;
+    // Set while requesting an item from the model, to identify asynchronous completion
+    bool inRequest;
+    // Set while completeIncubation advances the engine's incubator within the layout
+    bool inIncubation;
+
+    // Released delegates are parked here by index, up to poolSize, when reuseItems is set. This
+    // only delays the release: a parked item only comes back for the same index, e.g. when
+    // scrolling back. Reuse for a different index is done by the model, which needs Qt 5.15;
+    // before that, items leaving the pool are destroyed.
+    bool reuseItems;
+    int poolSize;
+    DelegateWindow parkedDelegates;
+    QList<QQuickItem*> parkOrder;
 
     int currentIndex;
     QQuickItem *currentItem;
@@ -62,30 +118,128 @@ public:
 
     QQmlChangeSet pendingChanges;
     QList<LayoutRow*> rows;
+    // Display height and spacing of each row, indexed in the same order as rows
+    RowOffsetIndex rowOffsets;
+    // Rows from this index on may have changed since their offsets were last indexed
+    int firstDirtyRow;
+    // Rows start at headIndex instead of the beginning of the model after jumping far ahead,
+    // with headHeight as the estimated height of the rows before it. Rows above are laid out
+    // upward as they're scrolled to, and the estimate is corrected while at rest.
+    int headIndex;
+    double headHeight;
+    // Whether any rows were laid out upward; these are reflowed from the top once headIndex is 0
+    bool hasPinnedRows;
 
-    QMap<int,double> cachedItemAspect;
-    QMap<int,QQuickItem*> delegates;
+    AspectStore cachedItemAspect;
+    DelegateWindow delegates;
+    // Index of every item in delegates or parkedDelegates, for size change notifications
+    QHash<QQuickItem*,int> itemIndexes;
+    // Indexes with implicit size changes since the last layout; an item usually changes both
+    // width and height at once, and many images finish loading together
+    QSet<int> sizeChangedIndexes;
 
     // Flag set by layout when no expensive operations (e.g. creating delegates) should be done
     bool cachedLayoutOnly;
 
+    // Content range covered by the rows positioned in the last layout. Scrolling within it
+    // doesn't need a layout.
+    double realizedMinY;
+    double realizedMaxY;
+
+    // Counters are only updated while stats exist and are enabled, and never with
+    // FITTINGGRIDVIEW_NO_STATS
+    FittingGridViewStats *stats;
+#ifndef FITTINGGRIDVIEW_NO_STATS
+    bool statsEnabled() const { return Q_UNLIKELY(stats && stats->m_enabled); }
+#else
+    bool statsEnabled() const { return false; }
+#endif
+    void updateStats();
+    int delegatesAlive() const { return delegates.count() + parkedDelegates.count(); }
+    // Start of the current stats pass, invalid outside of one
+    QElapsedTimer statsPassTimer;
+    bool beginStatsPass();
+    void endStatsPass(bool began);
+
+    // When aspects are known without delegates, rows for the whole model are laid out on
+    // layoutThread from a snapshot of cachedItemAspect. The view takes rows from the result as
+    // it walks to them, and measures the rest from it. Any change that affects existing rows
+    // increments layoutGeneration, which discards results from older snapshots.
+    QThreadPool layoutThread;
+    QSharedPointer<LayoutJob> layoutJob;
+    QSharedPointer<LayoutResult> layoutResult;
+    int layoutGeneration;
+    // Revision of cachedItemAspect used for layoutJob
+    int layoutJobRevision;
+    // Aspects copied so far for the next job, and the revision when copying started
+    QVector<double> layoutSnapshot;
+    int layoutSnapshotRevision;
+    // Aspects are read ahead from the model or cache for all indexes before this
+    int prefetchIndex;
+
     double layoutWidth() const;
+    void cacheMargins(double contentY, double *before, double *after) const;
+    LayoutParameters layoutParameters() const;
     void layoutChanged();
     void displayChanged();
+    void aspectsChanged();
     void applyPendingChanges();
+    void applyModelChanges();
+    QVector<int> applyDataChanges();
+    void reflowChanges(const QVector<int> &changed);
+    int reflowRows(int index);
     void layout();
     void layoutItems(double minY, double maxY);
     void updateContentSize();
+    double estimateContentHeight() const;
+    void estimateRowMetrics(double *itemsPerRow, double *rowHeight) const;
+    double estimateHeadHeight() const;
+    void anchorRows(int index);
+    bool anchorAtView();
+    double indexY(int index, double *height);
+    void positionViewAtIndex(int index, FittingGridView::PositionMode mode);
+    int indexAt(double x, double y) const;
+    void fillRowsBackward(double minY);
+    bool reconcileHead();
+    bool reflowPinnedRows();
+    void setContentHeight(double height, bool exact);
+    bool completeIncubation();
+    void invalidateBackgroundLayout();
+    bool prefetchAspects(int msecs);
+    void updateBackgroundLayout();
+    const LayoutResult *currentLayout() const;
+    int adoptableRow(const LayoutResult *result, int first) const;
+    bool headIsExact() const;
+    void invalidateProbes();
+    void updateProbes(int fromIndex);
+    QString sourcePath(int index);
 
     void createHighlight();
     void updateCurrent(int index);
 
     void clear();
 
-    int rowOf(int index);
+    int rowOf(int index) const;
+    int rowStartingBefore(int index) const;
+    double rowY(int row) const;
+    int rowFirstIndex(int row) const;
+    int rowAtY(double y) const;
+    void rowChanged(int row);
+    void rowDataChanged(int row);
     QQuickItem *createItem(int index, bool asynchronous = false);
+    void releaseItem(int index, QQuickItem *item);
+    void trimParked(int size);
+    void disposeItem(QQuickItem *item);
     double indexAspectRatio(int index);
+    double knownAspectRatio(int index);
+    bool hasModelAspects() const;
+    double modelAspectRatio(int index);
+    bool hasCachedAspects() const;
+    quint64 aspectCacheKey(int index);
     void updateItemSize(int index);
+    void itemSizeChanged(QQuickItem *item);
+    void applyItemSizes();
+    void rebuildItemIndexes();
     void applyPositions(LayoutRow *row, double y);
 
     int maximumLoadingRowItems() const;
@@ -97,7 +251,11 @@ public slots:
     void createdItem(int index, QObject *object);
     void initItem(int index, QObject *object);
     void destroyingItem(QObject *object);
+    void itemReused(int index, QObject *object);
     void modelUpdated(const QQmlChangeSet &changes, bool reset);
+    void backgroundLayoutFinished();
+    void probeFinished();
+    void contentYChanged();
 };
 
 #endif // FITTINGGRIDVIEW_P_H
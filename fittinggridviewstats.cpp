@@ -0,0 +1,57 @@
+/* Copyright (c) 2013 John Brooks <john.brooks@dereferenced.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "fittinggridviewstats.h"
+#include "fittinggridview_p.h"
+
+FittingGridViewStats::FittingGridViewStats(QObject *parent)
+    : QObject(parent)
+    , m_view(0)
+    , m_enabled(false)
+{
+    reset();
+}
+
+void FittingGridViewStats::setEnabled(bool enabled)
+{
+    if (m_enabled == enabled)
+        return;
+
+    m_enabled = enabled;
+    emit enabledChanged();
+}
+
+void FittingGridViewStats::reset()
+{
+    m_delegatesCreated = 0;
+    m_delegatesReleased = 0;
+    m_delegatesReused = 0;
+    // A gauge of the view rather than a counter
+    m_delegatesAlive = m_view ? m_view->delegatesAlive() : 0;
+    m_rowsRecomputed = 0;
+    m_rowsWalked = 0;
+    m_unpresentableRows = 0;
+    m_layoutTime = 0;
+    m_applyPendingChangesTime = 0;
+    m_applyPositionsTime = 0;
+    m_cachedAspects = 0;
+    m_knownAspects = 0;
+    emit updated();
+}
@@ -0,0 +1,115 @@
+/* Copyright (c) 2013 John Brooks <john.brooks@dereferenced.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef FITTINGGRIDVIEWSTATS_H
+#define FITTINGGRIDVIEWSTATS_H
+
+#include <QObject>
+
+class FittingGridViewPrivate;
+
+/* Performance counters of a FittingGridView, for finding out why a frame was slow.
+ *
+ * Nothing is counted until enabled is set. Counts of delegates are totals since the last
+ * reset(), and every item the view takes from or gives back to the model is counted, so
+ * delegatesCreated - delegatesReleased changes by as much as delegatesAlive. Row counts and times are for the most recent pass, which is a polish, a call to
+ * positionViewAtIndex(), or model changes applied outside of a polish (e.g. when currentIndex
+ * is set). Work done within a pass by another entry point counts towards the outer pass.
+ * updated() is emitted after every pass while enabled.
+ */
+class FittingGridViewStats : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit FittingGridViewStats(QObject *parent = 0);
+
+    Q_PROPERTY(bool enabled READ isEnabled WRITE setEnabled NOTIFY enabledChanged)
+    bool isEnabled() const { return m_enabled; }
+    void setEnabled(bool enabled);
+
+    Q_PROPERTY(int delegatesCreated READ delegatesCreated NOTIFY updated)
+    int delegatesCreated() const { return m_delegatesCreated; }
+
+    Q_PROPERTY(int delegatesReleased READ delegatesReleased NOTIFY updated)
+    int delegatesReleased() const { return m_delegatesReleased; }
+
+    // Items used again instead of being created: parked items that came back, which are not
+    // in delegatesCreated, and items the model rebound from its reuse pool, which are
+    Q_PROPERTY(int delegatesReused READ delegatesReused NOTIFY updated)
+    int delegatesReused() const { return m_delegatesReused; }
+
+    // Items the view holds right now, including parked ones; not reset by reset()
+    Q_PROPERTY(int delegatesAlive READ delegatesAlive NOTIFY updated)
+    int delegatesAlive() const { return m_delegatesAlive; }
+
+    Q_PROPERTY(int rowsRecomputed READ rowsRecomputed NOTIFY updated)
+    int rowsRecomputed() const { return m_rowsRecomputed; }
+
+    Q_PROPERTY(int rowsWalked READ rowsWalked NOTIFY updated)
+    int rowsWalked() const { return m_rowsWalked; }
+
+    Q_PROPERTY(int unpresentableRows READ unpresentableRows NOTIFY updated)
+    int unpresentableRows() const { return m_unpresentableRows; }
+
+    // Milliseconds for the whole pass
+    Q_PROPERTY(double layoutTime READ layoutTime NOTIFY updated)
+    double layoutTime() const { return m_layoutTime; }
+
+    Q_PROPERTY(double applyPendingChangesTime READ applyPendingChangesTime NOTIFY updated)
+    double applyPendingChangesTime() const { return m_applyPendingChangesTime; }
+
+    Q_PROPERTY(double applyPositionsTime READ applyPositionsTime NOTIFY updated)
+    double applyPositionsTime() const { return m_applyPositionsTime; }
+
+    // Number of items in the aspect cache, and how many of those have a known aspect
+    Q_PROPERTY(int cachedAspects READ cachedAspects NOTIFY updated)
+    int cachedAspects() const { return m_cachedAspects; }
+
+    Q_PROPERTY(int knownAspects READ knownAspects NOTIFY updated)
+    int knownAspects() const { return m_knownAspects; }
+
+    Q_INVOKABLE void reset();
+
+signals:
+    void enabledChanged();
+    void updated();
+
+private:
+    friend class FittingGridView;
+    friend class FittingGridViewPrivate;
+
+    FittingGridViewPrivate *m_view;
+    bool m_enabled;
+    int m_delegatesCreated;
+    int m_delegatesReleased;
+    int m_delegatesReused;
+    int m_delegatesAlive;
+    int m_rowsRecomputed;
+    int m_rowsWalked;
+    int m_unpresentableRows;
+    double m_layoutTime;
+    double m_applyPendingChangesTime;
+    double m_applyPositionsTime;
+    int m_cachedAspects;
+    int m_knownAspects;
+};
+
+#endif // FITTINGGRIDVIEWSTATS_H
@@ -0,0 +1,227 @@
+/* Copyright (c) 2013 John Brooks <john.brooks@dereferenced.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "imageheader_p.h"
+#include "tracing_p.h"
+#include <QFile>
+#include <QMetaObject>
+#include <cstring>
+
+static inline quint32 bigEndian16(const uchar *p)
+{
+    return (quint32(p[0]) << 8) | p[1];
+}
+
+static inline quint32 bigEndian32(const uchar *p)
+{
+    return (quint32(p[0]) << 24) | (quint32(p[1]) << 16) | (quint32(p[2]) << 8) | p[3];
+}
+
+static inline quint32 littleEndian16(const uchar *p)
+{
+    return quint32(p[0]) | (quint32(p[1]) << 8);
+}
+
+static inline quint32 littleEndian24(const uchar *p)
+{
+    return quint32(p[0]) | (quint32(p[1]) << 8) | (quint32(p[2]) << 16);
+}
+
+static inline quint32 littleEndian32(const uchar *p)
+{
+    return littleEndian24(p) | (quint32(p[3]) << 24);
+}
+
+static QSize pngSize(const uchar *p, int length)
+{
+    // Signature, then IHDR is always the first chunk
+    if (length < 24 || memcmp(p + 12, "IHDR", 4))
+        return QSize();
+    return QSize(bigEndian32(p + 16), bigEndian32(p + 20));
+}
+
+static QSize webpSize(const uchar *p, int length)
+{
+    if (length < 30)
+        return QSize();
+
+    const uchar *chunk = p + 12;
+    const uchar *data = p + 20;
+    if (!memcmp(chunk, "VP8 ", 4)) {
+        // Lossy: frame tag, start code, then 14 bit dimensions
+        if (data[3] != 0x9d || data[4] != 0x01 || data[5] != 0x2a)
+            return QSize();
+        return QSize((data[6] | (data[7] << 8)) & 0x3fff, (data[8] | (data[9] << 8)) & 0x3fff);
+    } else if (!memcmp(chunk, "VP8L", 4)) {
+        // Lossless: signature, then 14 bits each of width - 1 and height - 1
+        if (data[0] != 0x2f)
+            return QSize();
+        quint32 bits = data[1] | (data[2] << 8) | (data[3] << 16) | (quint32(data[4]) << 24);
+        return QSize((bits & 0x3fff) + 1, ((bits >> 14) & 0x3fff) + 1);
+    } else if (!memcmp(chunk, "VP8X", 4)) {
+        // Extended: flags, then 24 bits each of canvas width - 1 and height - 1
+        return QSize(littleEndian24(data + 4) + 1, littleEndian24(data + 7) + 1);
+    }
+    return QSize();
+}
+
+// Orientation tag of the first IFD in an APP1 segment of length bytes starting at the current
+// position, or 0 if it isn't EXIF or has no orientation
+static int exifOrientation(QIODevice *device, quint32 length)
+{
+    // Identifier, then the TIFF header with byte order and offset of the first IFD
+    uchar header[14];
+    if (length < sizeof(header) || device->read(reinterpret_cast<char*>(header), sizeof(header)) != sizeof(header)
+        || memcmp(header, "Exif\0\0", 6))
+        return 0;
+
+    const uchar *tiff = header + 6;
+    bool little = !memcmp(tiff, "II*\0", 4);
+    if (!little && memcmp(tiff, "MM\0*", 4))
+        return 0;
+    auto read16 = [little](const uchar *p) { return little ? littleEndian16(p) : bigEndian16(p); };
+    auto read32 = [little](const uchar *p) { return little ? littleEndian32(p) : bigEndian32(p); };
+
+    // Offsets are from the start of the TIFF header
+    qint64 tiffStart = device->pos() - 8;
+    quint32 tiffLength = length - 6;
+    quint32 ifd = read32(tiff + 4);
+    uchar entry[12];
+    if (ifd < 8 || ifd > tiffLength - 2 || !device->seek(tiffStart + ifd) || device->read(reinterpret_cast<char*>(entry), 2) != 2)
+        return 0;
+
+    quint32 count = read16(entry);
+    for (quint32 i = 0; i < count && ifd + 2 + (i + 1) * 12 <= tiffLength; i++) {
+        if (device->read(reinterpret_cast<char*>(entry), 12) != 12)
+            return 0;
+        // A SHORT, in the first two bytes of the value
+        if (read16(entry) == 0x0112)
+            return read16(entry + 8);
+    }
+    return 0;
+}
+
+static QSize jpegSize(QIODevice *device)
+{
+    // Skip the SOI marker
+    if (!device->seek(2))
+        return QSize();
+
+    uchar header[9];
+    int orientation = 0;
+    for (;;) {
+        // Markers may be preceded by any number of fill bytes
+        char c;
+        do {
+            if (!device->getChar(&c))
+                return QSize();
+        } while (uchar(c) != 0xff);
+        do {
+            if (!device->getChar(&c))
+                return QSize();
+        } while (uchar(c) == 0xff);
+
+        uchar marker = c;
+        // Markers without a length
+        if ((marker >= 0xd0 && marker <= 0xd7) || marker == 0x01)
+            continue;
+        // End of image, or start of scan without having seen a frame
+        if (marker == 0xd9 || marker == 0xda)
+            return QSize();
+
+        if (device->read(reinterpret_cast<char*>(header), 2) != 2)
+            return QSize();
+        quint32 length = bigEndian16(header);
+        if (length < 2)
+            return QSize();
+        qint64 next = device->pos() + length - 2;
+
+        // Start of frame markers, except DHT (c4), JPG (c8) and DAC (cc)
+        if (marker >= 0xc0 && marker <= 0xcf && marker != 0xc4 && marker != 0xc8 && marker != 0xcc) {
+            if (length < 7 || device->read(reinterpret_cast<char*>(header + 2), 5) != 5)
+                return QSize();
+            // Precision, height, width. Orientations 5 to 8 are displayed rotated by 90 degrees.
+            QSize size(bigEndian16(header + 5), bigEndian16(header + 3));
+            return (orientation >= 5 && orientation <= 8) ? size.transposed() : size;
+        }
+
+        // APP1, which is EXIF data when it comes before the frame
+        if (marker == 0xe1 && !orientation)
+            orientation = exifOrientation(device, length - 2);
+
+        if (!device->seek(next))
+            return QSize();
+    }
+}
+
+QSize ImageHeader::size(QIODevice *device)
+{
+    uchar p[30];
+    qint64 length = device->read(reinterpret_cast<char*>(p), sizeof(p));
+    if (length < 4)
+        return QSize();
+
+    QSize size;
+    if (length >= 8 && !memcmp(p, "\x89PNG\r\n\x1a\n", 8))
+        size = pngSize(p, length);
+    else if (length >= 12 && !memcmp(p, "RIFF", 4) && !memcmp(p + 8, "WEBP", 4))
+        size = webpSize(p, length);
+    else if (p[0] == 0xff && p[1] == 0xd8)
+        size = jpegSize(device);
+
+    if (size.isEmpty())
+        return QSize();
+    return size;
+}
+
+QSize ImageHeader::size(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+        return QSize();
+    return size(&file);
+}
+
+ProbeTask::ProbeTask(const QSharedPointer<ProbeJob> &job, QObject *receiver, const char *finishedSlot)
+    : m_job(job)
+    , m_receiver(receiver)
+    , m_finishedSlot(finishedSlot)
+{
+}
+
+void ProbeTask::run()
+{
+    TRACE("probeImages");
+    QVector<double> aspects;
+    aspects.reserve(m_job->paths.size());
+    foreach (const QString &path, m_job->paths) {
+        if (m_job->cancelled.load())
+            return;
+        QSize size = ImageHeader::size(path);
+        aspects.append(size.isValid() ? (double(size.width()) / size.height()) : 0);
+    }
+
+    {
+        QMutexLocker locker(&m_job->mutex);
+        m_job->aspects = aspects;
+        m_job->finished = true;
+    }
+    QMetaObject::invokeMethod(m_receiver, m_finishedSlot, Qt::QueuedConnection);
+}
@@ -0,0 +1,81 @@
+/* Copyright (c) 2013 John Brooks <john.brooks@dereferenced.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef IMAGEHEADER_P_H
+#define IMAGEHEADER_P_H
+
+#include <QAtomicInt>
+#include <QMutex>
+#include <QRunnable>
+#include <QSharedPointer>
+#include <QSize>
+#include <QStringList>
+#include <QVector>
+
+class QIODevice;
+class QObject;
+
+/* Image dimensions read from the header of JPEG, PNG and WebP files, without decoding.
+ *
+ * PNG and WebP have their size within the first 30 bytes. JPEG files are walked segment by
+ * segment to the start of frame, seeking over the contents of each segment, so even files with
+ * large embedded thumbnails only read a few bytes per segment. Their size is as displayed with
+ * the EXIF orientation applied, so rotated photos have the aspect they're shown with.
+ */
+namespace ImageHeader {
+    // Returns an invalid size if the format isn't recognized or the header is damaged
+    QSize size(QIODevice *device);
+    QSize size(const QString &path);
+}
+
+// Paths to read the sizes of, by model index, and their aspect ratios once finished
+class ProbeJob
+{
+public:
+    ProbeJob() : rechecks(0), finished(false) { }
+
+    QVector<int> indexes;
+    // The first rechecks indexes already had an aspect, but their source may have changed
+    int rechecks;
+    QStringList paths;
+    QAtomicInt cancelled;
+
+    QMutex mutex;
+    bool finished;
+    // Width / height for each path, or 0 if it couldn't be read
+    QVector<double> aspects;
+};
+
+/* Reads the headers of a job, then invokes the finished slot of the receiver with a queued
+ * connection. The receiver must outlive the task, e.g. by owning the thread pool.
+ */
+class ProbeTask : public QRunnable
+{
+public:
+    ProbeTask(const QSharedPointer<ProbeJob> &job, QObject *receiver, const char *finishedSlot);
+    void run();
+
+private:
+    QSharedPointer<ProbeJob> m_job;
+    QObject *m_receiver;
+    const char *m_finishedSlot;
+};
+
+#endif // IMAGEHEADER_P_H
@@ -0,0 +1,113 @@
+/* Copyright (c) 2013 John Brooks <john.brooks@dereferenced.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "indexremap_p.h"
+#include <QtQml/private/qqmlchangeset_p.h>
+#include <algorithm>
+
+IndexRemap::IndexRemap(const QQmlChangeSet &changes)
+{
+    int removed = 0;
+    foreach (const QQmlChangeSet::Change &remove, changes.removes()) {
+        m_removeStarts.append(remove.index + removed);
+        m_removeEnds.append(remove.index + removed + remove.count);
+        removed += remove.count;
+        m_removedThrough.append(removed);
+        m_removeMoveIds.append(remove.moveId);
+        m_removeOffsets.append(remove.offset);
+    }
+
+    int inserted = 0;
+    foreach (const QQmlChangeSet::Change &insert, changes.inserts()) {
+        m_insertPositions.append(insert.index - inserted);
+        inserted += insert.count;
+        m_insertedThrough.append(inserted);
+        if (insert.isMove()) {
+            MoveTarget target = { insert.moveId, insert.offset, insert.count, insert.index };
+            m_moveTargets.append(target);
+        }
+    }
+
+    std::sort(m_moveTargets.begin(), m_moveTargets.end(), [](const MoveTarget &a, const MoveTarget &b) {
+        return a.moveId < b.moveId || (a.moveId == b.moveId && a.offset < b.offset);
+    });
+}
+
+int IndexRemap::removeAt(int index) const
+{
+    int k = int(std::upper_bound(m_removeStarts.begin(), m_removeStarts.end(), index) - m_removeStarts.begin()) - 1;
+    return (k >= 0 && index < m_removeEnds[k]) ? k : -1;
+}
+
+int IndexRemap::map(int index) const
+{
+    int k = removeAt(index);
+    if (k < 0)
+        return afterInserts(afterRemoves(index));
+    if (m_removeMoveIds[k] < 0)
+        return -1;
+
+    // The last part of the move that starts at or before this item
+    MoveTarget key = { m_removeMoveIds[k], m_removeOffsets[k] + index - m_removeStarts[k], 0, 0 };
+    auto it = std::upper_bound(m_moveTargets.begin(), m_moveTargets.end(), key, [](const MoveTarget &a, const MoveTarget &b) {
+        return a.moveId < b.moveId || (a.moveId == b.moveId && a.offset < b.offset);
+    });
+    if (it == m_moveTargets.begin())
+        return -1;
+    --it;
+    if (it->moveId != key.moveId || key.offset >= it->offset + it->count)
+        return -1;
+    return it->index + key.offset - it->offset;
+}
+
+int IndexRemap::afterRemoves(int index, bool *removed) const
+{
+    int k = int(std::upper_bound(m_removeStarts.begin(), m_removeStarts.end(), index) - m_removeStarts.begin()) - 1;
+    bool isRemoved = (k >= 0 && index < m_removeEnds[k]);
+    if (removed)
+        *removed = isRemoved;
+
+    if (isRemoved)
+        return m_removeStarts[k] - (k ? m_removedThrough[k-1] : 0);
+    return index - (k >= 0 ? m_removedThrough[k] : 0);
+}
+
+int IndexRemap::afterInserts(int position) const
+{
+    int j = int(std::upper_bound(m_insertPositions.begin(), m_insertPositions.end(), position) - m_insertPositions.begin());
+    return position + (j ? m_insertedThrough[j-1] : 0);
+}
+
+QVector<int> IndexRemap::changedPositions() const
+{
+    QVector<int> positions;
+    positions.reserve(m_removeStarts.size() + m_insertPositions.size());
+
+    // Just after the item before each removal, which is also before anything inserted there
+    for (int k = 0; k < m_removeStarts.size(); k++) {
+        int position = m_removeStarts[k] - (k ? m_removedThrough[k-1] : 0);
+        positions.append(position ? (afterInserts(position - 1) + 1) : 0);
+    }
+    for (int j = 0; j < m_insertPositions.size(); j++)
+        positions.append(m_insertPositions[j] + (j ? m_insertedThrough[j-1] : 0));
+
+    std::sort(positions.begin(), positions.end());
+    return positions;
+}
@@ -0,0 +1,80 @@
+/* Copyright (c) 2013 John Brooks <john.brooks@dereferenced.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef INDEXREMAP_P_H
+#define INDEXREMAP_P_H
+
+#include <QVector>
+
+class QQmlChangeSet;
+
+/* Maps indexes from before a QQmlChangeSet to after it, for the whole set at once.
+ *
+ * A change set's removes are sorted, with each index counted after the removes before it,
+ * and the same goes for inserts, which are applied after all removes. Both are converted
+ * to cumulative tables here, so that any index can be mapped through all changes with two
+ * binary searches instead of one pass per change.
+ *
+ * Moves arrive as a remove and an insert with the same moveId. Items removed by a move map
+ * to where they were inserted, and are otherwise treated like any other remove and insert.
+ */
+class IndexRemap
+{
+public:
+    explicit IndexRemap(const QQmlChangeSet &changes);
+
+    // New index of index, or -1 if it was removed. Moved items map to their destination, so
+    // this isn't always in order.
+    int map(int index) const;
+
+    // Position of index after the removes, which for a removed index is where it was removed
+    int afterRemoves(int index, bool *removed = 0) const;
+    // Final position of a position after the removes; items inserted at it come before it
+    int afterInserts(int position) const;
+
+    // Final positions where items were removed or inserted, in order
+    QVector<int> changedPositions() const;
+
+private:
+    struct MoveTarget {
+        int moveId;
+        int offset;
+        int count;
+        int index;
+    };
+
+    // Removed ranges in original indexes, and the total removed up to and including each
+    QVector<int> m_removeStarts;
+    QVector<int> m_removeEnds;
+    QVector<int> m_removedThrough;
+    // Move of each remove, and the offset of its first item within the move
+    QVector<int> m_removeMoveIds;
+    QVector<int> m_removeOffsets;
+    // Final indexes of the inserted parts of moves, sorted by moveId and offset
+    QVector<MoveTarget> m_moveTargets;
+    // Insert positions in indexes after the removes, and the total inserted up to each
+    QVector<int> m_insertPositions;
+    QVector<int> m_insertedThrough;
+
+    // Position of the removed range containing index, or -1
+    int removeAt(int index) const;
+};
+
+#endif // INDEXREMAP_P_H
@@ -0,0 +1,116 @@
+/* Copyright (c) 2013 John Brooks <john.brooks@dereferenced.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "layoutengine_p.h"
+#include "tracing_p.h"
+#include <QMetaObject>
+#include <algorithm>
+
+int LayoutResult::rowStartingAt(int index) const
+{
+    auto it = std::lower_bound(rowFirst.constBegin(), rowFirst.constEnd(), index);
+    if (it == rowFirst.constEnd() || *it != index)
+        return -1;
+    return it - rowFirst.constBegin();
+}
+
+int LayoutResult::rowContaining(int index) const
+{
+    auto it = std::upper_bound(rowFirst.constBegin(), rowFirst.constEnd(), index);
+    return int(it - rowFirst.constBegin()) - 1;
+}
+
+int LayoutResult::rowAtOffset(double offset) const
+{
+    auto it = std::upper_bound(rowOffset.constBegin(), rowOffset.constEnd(), offset);
+    return qMax(int(it - rowOffset.constBegin()) - 1, 0);
+}
+
+QSharedPointer<LayoutResult> LayoutEngine::layout(const LayoutParameters &p, int generation,
+                                                  const QVector<double> &aspects, const QAtomicInt &cancelled)
+{
+    QSharedPointer<LayoutResult> result(new LayoutResult);
+    result->parameters = p;
+    result->generation = generation;
+    result->aspects = aspects;
+    result->firstLoadingRow = -1;
+    result->totalHeight = 0;
+
+    const double *data = aspects.constData();
+    auto aspectOf = [data](int i) { return qMax(data[i], 0.0); };
+
+    int count = aspects.size();
+    for (int first = 0; first < count; ) {
+        if (!(result->rowFirst.size() % 1024) && cancelled.load())
+            return QSharedPointer<LayoutResult>();
+
+        int last = first;
+        double aspect = aspectOf(first);
+        int loading = aspect ? 0 : 1;
+        int optimalLast = p.optimal ? optimalRowLast(p, first, count - 1, aspectOf) : -1;
+        if (optimalLast >= 0) {
+            for (last = first + 1; last <= optimalLast; last++)
+                aspect += aspectOf(last);
+            last = optimalLast;
+        } else {
+            extendRow(p, first, count - 1, &last, &aspect, &loading, aspectOf);
+        }
+
+        // Rows with unknown items take maximumHeight, as they do in the view
+        double height = loading ? p.maximumHeight : rowHeight(p.spacing, last - first + 1, p.displayWidth, aspect);
+
+        result->rowFirst.append(first);
+        result->rowAspect.append(aspect);
+        result->rowHeight.append(height);
+        result->rowLoading.append(loading > 0);
+        if (loading && result->firstLoadingRow < 0)
+            result->firstLoadingRow = result->rowCount() - 1;
+        result->rowOffset.append(result->totalHeight);
+        result->totalHeight += height + p.spacing;
+
+        first = last + 1;
+    }
+
+    if (result->firstLoadingRow < 0)
+        result->firstLoadingRow = result->rowCount();
+    return result;
+}
+
+LayoutTask::LayoutTask(const QSharedPointer<LayoutJob> &job, QObject *receiver, const char *finishedSlot)
+    : m_job(job)
+    , m_receiver(receiver)
+    , m_finishedSlot(finishedSlot)
+{
+}
+
+void LayoutTask::run()
+{
+    TRACE("backgroundLayout");
+    QSharedPointer<LayoutResult> result = LayoutEngine::layout(m_job->parameters, m_job->generation,
+                                                               m_job->aspects, m_job->cancelled);
+    if (!result)
+        return;
+
+    {
+        QMutexLocker locker(&m_job->mutex);
+        m_job->result = result;
+    }
+    QMetaObject::invokeMethod(m_receiver, m_finishedSlot, Qt::QueuedConnection);
+}
@@ -0,0 +1,251 @@
+/* Copyright (c) 2013 John Brooks <john.brooks@dereferenced.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef LAYOUTENGINE_P_H
+#define LAYOUTENGINE_P_H
+
+#include <QVector>
+#include <QSharedPointer>
+#include <QAtomicInt>
+#include <QMutex>
+#include <QRunnable>
+#include <QVarLengthArray>
+
+struct LayoutParameters
+{
+    double layoutWidth;
+    double displayWidth;
+    double maximumHeight;
+    int spacing;
+    int maximumLoadingRowItems;
+    // Use optimal instead of greedy row breaks
+    bool optimal;
+};
+
+/* Result of laying out every row of a snapshot of aspect ratios */
+class LayoutResult
+{
+public:
+    LayoutParameters parameters;
+    // Generation of the view's layout when the snapshot was taken
+    int generation;
+    // Aspect ratios used for this layout, with negative values for unknown items
+    QVector<double> aspects;
+
+    // First index, sum of aspects, and display height of each row
+    QVector<int> rowFirst;
+    QVector<double> rowAspect;
+    QVector<double> rowHeight;
+    // Whether any items in the row had unknown aspects
+    QVector<bool> rowLoading;
+    // First row with unknown aspects, or rowCount() if there are none
+    int firstLoadingRow;
+    // Sum of display heights and spacing of all rows before each row, and in total
+    QVector<double> rowOffset;
+    double totalHeight;
+
+    int rowCount() const { return rowFirst.size(); }
+    int rowLast(int row) const { return row + 1 < rowFirst.size() ? rowFirst[row + 1] - 1 : aspects.size() - 1; }
+    // Row starting at exactly index, or -1
+    int rowStartingAt(int index) const;
+    // Row containing index, which must be within aspects
+    int rowContaining(int index) const;
+    // Row at offset from the top, or the first or last row outside of the layout
+    int rowAtOffset(double offset) const;
+};
+
+/* Row partitioning, independent of QtQuick so it can be used both by the view and on
+ * a worker thread.
+ *
+ * Rows are filled greedily: items are added to a row until its height at layoutWidth
+ * is at most maximumHeight. Items with unknown aspect ratios count as 0, and a row
+ * with any of those stops growing at maximumLoadingRowItems.
+ *
+ * In optimal mode, the breaks of a row are chosen by partitioning the items of the next
+ * windowRows greedy rows to minimize the total cost of their heights. Only the first row
+ * of that partition is used, so the break of a row depends on no items past its window,
+ * and a change to one item only affects the windowRows rows up to and including its own.
+ */
+class LayoutEngine
+{
+public:
+    static const int windowRows = 5;
+
+    static double rowHeight(int spacing, int count, double width, double aspect)
+    {
+        if (!aspect || !count)
+            return 0;
+        return qRound((width - ((count - 1) * spacing)) / aspect);
+    }
+
+    // Add items after *last to the row until it meets the layout requirements. Returns true if
+    // any items were added; *last, *aspect and *loading are updated for the new row.
+    template<typename AspectFunc>
+    static bool extendRow(const LayoutParameters &p, int first, int maxLast, int *last, double *aspect,
+                          int *loading, AspectFunc aspectOf)
+    {
+        bool extended = false;
+        while (*last < maxLast
+               && (!*aspect || rowHeight(p.spacing, *last - first + 1, p.layoutWidth, *aspect) > p.maximumHeight)
+               && (!*loading || (*last - first + 1) < p.maximumLoadingRowItems))
+        {
+            double itemAspect = aspectOf(*last + 1);
+            (*last)++;
+            *aspect += itemAspect;
+            if (!itemAspect)
+                (*loading)++;
+            extended = true;
+        }
+        return extended;
+    }
+
+    // Add items before *first to a row ending at last, until it meets the same requirements as
+    // extendRow. Used to lay out rows upward from a row whose position is already decided.
+    template<typename AspectFunc>
+    static bool extendRowBackward(const LayoutParameters &p, int minFirst, int last, int *first, double *aspect,
+                                  int *loading, AspectFunc aspectOf)
+    {
+        bool extended = false;
+        while (*first > minFirst
+               && (!*aspect || rowHeight(p.spacing, last - *first + 1, p.layoutWidth, *aspect) > p.maximumHeight)
+               && (!*loading || (last - *first + 1) < p.maximumLoadingRowItems))
+        {
+            double itemAspect = aspectOf(*first - 1);
+            (*first)--;
+            *aspect += itemAspect;
+            if (!itemAspect)
+                (*loading)++;
+            extended = true;
+        }
+        return extended;
+    }
+
+    // Remove items from the end of the row for as long as it would still meet the layout
+    // requirements without them. Returns true if any items were removed.
+    template<typename AspectFunc>
+    static bool shrinkRow(const LayoutParameters &p, int first, int *last, double *aspect, AspectFunc aspectOf)
+    {
+        bool shrunk = false;
+        while (*last > first) {
+            double newAspect = *aspect - aspectOf(*last);
+            if (rowHeight(p.spacing, *last - first, p.layoutWidth, newAspect) > p.maximumHeight)
+                break;
+            (*last)--;
+            *aspect = newAspect;
+            shrunk = true;
+        }
+        return shrunk;
+    }
+
+    // Squared distance from maximumHeight, with rows taller than maximumHeight (which greedy
+    // rows only allow for single items or at the end) penalized heavily
+    static double rowCost(const LayoutParameters &p, double height)
+    {
+        double d = p.maximumHeight - height;
+        return (d >= 0) ? (d * d) : (d * d * 100);
+    }
+
+    // Returns the last index of the optimal row starting at first, or -1 if any items in
+    // its window are unknown.
+    template<typename AspectFunc>
+    static int optimalRowLast(const LayoutParameters &p, int first, int maxLast, AspectFunc aspectOf)
+    {
+        // The window ends at a greedy break, so the partition of it is never worse than greedy
+        QVarLengthArray<double, 64> sums;
+        sums.append(0);
+        auto collect = [&sums, &aspectOf](int i) {
+            double aspect = aspectOf(i);
+            sums.append(sums.last() + aspect);
+            return aspect;
+        };
+
+        int end = first - 1;
+        for (int r = 0; r < windowRows && end < maxLast; r++) {
+            int rowFirst = end + 1;
+            int last = rowFirst;
+            double aspect = collect(rowFirst);
+            int loading = aspect ? 0 : 1;
+            extendRow(p, rowFirst, maxLast, &last, &aspect, &loading, collect);
+            if (loading)
+                return -1;
+            end = last;
+        }
+
+        // cost[j] is the lowest cost of rows for the first j items of the window, with the
+        // last of those rows starting at item start[j]
+        int n = end - first + 1;
+        QVarLengthArray<double, 64> cost(n + 1);
+        QVarLengthArray<int, 64> start(n + 1);
+        cost[0] = 0;
+        for (int j = 1; j <= n; j++) {
+            cost[j] = -1;
+            for (int i = j - 1; i >= 0; i--) {
+                double height = rowHeight(p.spacing, j - i, p.layoutWidth, sums[j] - sums[i]);
+                double c = cost[i] + rowCost(p, height);
+                if (cost[j] < 0 || c < cost[j]) {
+                    cost[j] = c;
+                    start[j] = i;
+                }
+                // Rows only get shorter with more items
+                if (height < p.maximumHeight / 4)
+                    break;
+            }
+        }
+
+        int j = n;
+        while (start[j] > 0)
+            j = start[j];
+        return first + j - 1;
+    }
+
+    // Lay out every row from the beginning. Returns null if cancelled is set before finishing.
+    static QSharedPointer<LayoutResult> layout(const LayoutParameters &p, int generation,
+                                               const QVector<double> &aspects, const QAtomicInt &cancelled);
+};
+
+/* Shared between the view and a background layout task */
+class LayoutJob
+{
+public:
+    LayoutParameters parameters;
+    int generation;
+    QVector<double> aspects;
+
+    QAtomicInt cancelled;
+    QMutex mutex;
+    QSharedPointer<LayoutResult> result;
+};
+
+/* Runs LayoutEngine::layout() for a job, then invokes the finished slot of the receiver with a
+ * queued connection. The receiver must outlive the task, e.g. by owning the thread pool.
+ */
+class LayoutTask : public QRunnable
+{
+public:
+    LayoutTask(const QSharedPointer<LayoutJob> &job, QObject *receiver, const char *finishedSlot);
+    void run();
+
+private:
+    QSharedPointer<LayoutJob> m_job;
+    QObject *m_receiver;
+    const char *m_finishedSlot;
+};
+
+#endif // LAYOUTENGINE_P_H
@@ -1,5 +1,7 @@
 #include "plugin.h"
 #include "fittinggridview.h"
+#include "fittinggridviewstats.h"
+#include "fittinggridimage.h"
 
 #include <qqml.h>
 
@@ -7,4 +9,7 @@ void FittingGridViewPlugin::registerTypes(const char *uri)
 {
     // @uri FittingGridView
     qmlRegisterType<FittingGridView>(uri, 1, 0, "FittingGridView");
+    qmlRegisterType<FittingGridImage>(uri, 1, 0, "FittingGridImage");
+    qmlRegisterUncreatableType<FittingGridViewStats>(uri, 1, 0, "FittingGridViewStats",
+                                                     "FittingGridViewStats is only available from FittingGridView.stats");
 }
@@ -0,0 +1,134 @@
+/* Copyright (c) 2013 John Brooks <john.brooks@dereferenced.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "rowoffsetindex_p.h"
+
+static inline int lowbit(int i)
+{
+    return i & -i;
+}
+
+void RowOffsetIndex::clear()
+{
+    m_values.clear();
+    m_tree.clear();
+    m_origin = 0;
+}
+
+void RowOffsetIndex::resize(int size)
+{
+    if (size <= 0) {
+        clear();
+        return;
+    }
+
+    if (size < this->size()) {
+        // Nodes only ever cover slots before their own index, so truncating is free
+        m_values.resize(m_origin + size);
+        m_tree.resize(m_origin + size + 1);
+        return;
+    }
+
+    while (this->size() < size)
+        append(0);
+}
+
+void RowOffsetIndex::append(double value)
+{
+    if (m_tree.isEmpty())
+        m_tree.append(0);
+
+    int i = m_values.size() + 1;
+    m_values.append(value);
+    m_tree.append(value + prefix(i - 1) - prefix(i - lowbit(i)));
+}
+
+void RowOffsetIndex::prepend(double value)
+{
+    if (!m_origin) {
+        // Rebuild with as many free slots as there are rows, which keeps prepending
+        // amortized O(log n)
+        int headroom = qMax(16, size());
+        QVector<double> values(headroom, 0);
+        values += m_values;
+
+        m_values = values;
+        m_origin = headroom;
+        m_tree.fill(0, m_values.size() + 1);
+        for (int i = 1; i < m_tree.size(); i++) {
+            m_tree[i] += m_values[i - 1];
+            int parent = i + lowbit(i);
+            if (parent < m_tree.size())
+                m_tree[parent] += m_tree[i];
+        }
+    }
+
+    // The slot is unused and 0, so this is the same as setting its value
+    m_origin--;
+    m_values[m_origin] = 0;
+    setValue(0, value);
+}
+
+void RowOffsetIndex::setValue(int row, double value)
+{
+    Q_ASSERT(row >= 0 && row < size());
+
+    int slot = m_origin + row;
+    double delta = value - m_values[slot];
+    if (!delta)
+        return;
+
+    m_values[slot] = value;
+    for (int i = slot + 1; i < m_tree.size(); i += lowbit(i))
+        m_tree[i] += delta;
+}
+
+double RowOffsetIndex::offset(int row) const
+{
+    Q_ASSERT(row >= 0 && row <= size());
+
+    // Unused slots before the origin are all 0
+    return prefix(m_origin + row);
+}
+
+double RowOffsetIndex::prefix(int slot) const
+{
+    double sum = 0;
+    for (int i = slot; i > 0; i -= lowbit(i))
+        sum += m_tree[i];
+    return sum;
+}
+
+int RowOffsetIndex::rowAt(double offset) const
+{
+    int n = m_values.size();
+    int step = 1;
+    while (step * 2 <= n)
+        step *= 2;
+
+    int slot = 0;
+    for (; step > 0; step /= 2) {
+        if (slot + step <= n && m_tree[slot + step] <= offset) {
+            slot += step;
+            offset -= m_tree[slot];
+        }
+    }
+    return qMax(slot - m_origin, 0);
+}
@@ -0,0 +1,70 @@
+/* Copyright (c) 2013 John Brooks <john.brooks@dereferenced.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef ROWOFFSETINDEX_P_H
+#define ROWOFFSETINDEX_P_H
+
+#include <QVector>
+
+/* Prefix sums over the heights of layout rows, as a Fenwick tree. This answers
+ * both "what is the offset of row N" and "which row is at offset Y" in O(log n),
+ * and changing the height of any single row is also O(log n).
+ *
+ * Rows can also be prepended, for layouts that grow upward. The tree keeps unused
+ * zero slots before the first row for that, so prepending is O(log n) until they
+ * run out and the tree is rebuilt with more.
+ */
+class RowOffsetIndex
+{
+public:
+    RowOffsetIndex() : m_origin(0) { }
+
+    int size() const { return m_values.size() - m_origin; }
+    bool isEmpty() const { return !size(); }
+
+    void clear();
+    // Truncate or extend with zero values
+    void resize(int size);
+    void append(double value);
+    void prepend(double value);
+
+    double value(int row) const { return m_values[m_origin + row]; }
+    void setValue(int row, double value);
+
+    // Sum of the values of all rows before row
+    double offset(int row) const;
+    double total() const { return offset(size()); }
+
+    // Returns the row containing offset, which is the last row with offset(row) <= offset.
+    // Returns size() if offset is past the end of all rows.
+    int rowAt(double offset) const;
+
+private:
+    // Values of all slots, with rows starting at m_origin
+    QVector<double> m_values;
+    // 1-based; m_tree[i] is the sum of slot values in [i - lowbit(i), i)
+    QVector<double> m_tree;
+    int m_origin;
+
+    // Sum of the values of all slots before slot
+    double prefix(int slot) const;
+};
+
+#endif // ROWOFFSETINDEX_P_H
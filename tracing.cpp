@@ -0,0 +1,117 @@
+/* Copyright (c) 2013 John Brooks <john.brooks@dereferenced.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "tracing_p.h"
+#include <QCoreApplication>
+#include <QFile>
+#include <QSaveFile>
+#include <QThread>
+#include <chrono>
+
+static void dumpAtExit()
+{
+    Tracer *tracer = Tracer::instance();
+    tracer->dump(tracer->autoDumpPath());
+}
+
+Tracer::Tracer()
+    : m_enabled(false)
+{
+    QByteArray value = qgetenv("FITTINGGRIDVIEW_TRACE");
+    if (value.isEmpty() || value == "0")
+        return;
+
+    m_enabled = true;
+    m_events.resize(capacity);
+    if (value != "1") {
+        // Once for the whole process, when the application object is destroyed
+        m_autoDumpPath = QFile::decodeName(value);
+        qAddPostRoutine(dumpAtExit);
+    }
+}
+
+Tracer *Tracer::instance()
+{
+    static Tracer tracer;
+    return &tracer;
+}
+
+qint64 Tracer::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Tracer::record(const char *name, qint64 start, qint64 end, int arg)
+{
+    Event &event = m_events[m_next.fetchAndAddRelaxed(1) & (capacity - 1)];
+    event.name = name;
+    event.start = start;
+    event.duration = end - start;
+    event.arg = arg;
+    event.thread = quint64(quintptr(QThread::currentThreadId()));
+}
+
+bool Tracer::dump(const QString &path) const
+{
+    if (!m_enabled)
+        return false;
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+        return false;
+
+    // The counter keeps going past capacity, so the oldest event is the one after the newest
+    unsigned int next = unsigned(m_next.load());
+    unsigned int count = qMin(next, unsigned(capacity));
+    qint64 pid = QCoreApplication::applicationPid();
+
+    QByteArray out = "{\"traceEvents\":[\n";
+    bool first = true;
+    for (unsigned int i = next - count; i != next; i++) {
+        const Event &event = m_events[i & (capacity - 1)];
+        if (!event.name)
+            continue;
+
+        if (!first)
+            out += ",\n";
+        first = false;
+        out += "{\"name\":\"";
+        out += event.name;
+        out += "\",\"cat\":\"FittingGridView\",\"ph\":\"X\",\"ts\":";
+        out += QByteArray::number(event.start / 1000.0, 'f', 3);
+        out += ",\"dur\":";
+        out += QByteArray::number(event.duration / 1000.0, 'f', 3);
+        out += ",\"pid\":";
+        out += QByteArray::number(pid);
+        out += ",\"tid\":";
+        out += QByteArray::number(event.thread);
+        if (event.arg >= 0) {
+            out += ",\"args\":{\"index\":";
+            out += QByteArray::number(event.arg);
+            out += "}";
+        }
+        out += "}";
+    }
+    out += "\n]}\n";
+
+    file.write(out);
+    return file.commit();
+}
@@ -0,0 +1,109 @@
+/* Copyright (c) 2013 John Brooks <john.brooks@dereferenced.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef TRACING_P_H
+#define TRACING_P_H
+
+#include <QAtomicInt>
+#include <QString>
+#include <QVector>
+
+/* Process-wide trace of timed scopes, for lining up slow layouts with other traces.
+ *
+ * Tracing is enabled by setting FITTINGGRIDVIEW_TRACE in the environment. If its value
+ * is a path rather than "1", the trace is written there once at application exit; it can
+ * also be written at any time with FittingGridView.dumpTrace(). The output is Chrome trace
+ * event JSON, which chrome://tracing and Perfetto can open, with timestamps from the
+ * monotonic clock.
+ *
+ * Events go into a fixed size ring buffer which keeps the most recent events. Any thread
+ * can record without locking; an event that is overwritten while it's being dumped can come
+ * out inconsistent, which is acceptable for a diagnostic trace.
+ */
+class Tracer
+{
+public:
+    static Tracer *instance();
+
+    bool isEnabled() const { return m_enabled; }
+    // Path from the environment to dump to automatically, if any
+    QString autoDumpPath() const { return m_autoDumpPath; }
+
+    static qint64 now();
+    void record(const char *name, qint64 start, qint64 end, int arg);
+    bool dump(const QString &path) const;
+
+private:
+    Tracer();
+
+    struct Event
+    {
+        // Always a string literal
+        const char *name;
+        qint64 start;
+        qint64 duration;
+        int arg;
+        quint64 thread;
+    };
+
+    static const int capacity = 1 << 16;
+
+    bool m_enabled;
+    QString m_autoDumpPath;
+    QVector<Event> m_events;
+    QAtomicInt m_next;
+};
+
+// Records the time from construction to destruction, if tracing is enabled
+class TraceScope
+{
+public:
+    explicit TraceScope(const char *name, int arg = -1)
+        : m_name(0)
+        , m_arg(arg)
+    {
+        Tracer *tracer = Tracer::instance();
+        if (Q_UNLIKELY(tracer->isEnabled())) {
+            m_name = name;
+            m_start = Tracer::now();
+        }
+    }
+
+    ~TraceScope()
+    {
+        if (Q_UNLIKELY(m_name))
+            Tracer::instance()->record(m_name, m_start, Tracer::now(), m_arg);
+    }
+
+private:
+    const char *m_name;
+    int m_arg;
+    qint64 m_start;
+};
+
+#ifndef FITTINGGRIDVIEW_NO_TRACE
+#define TRACE(name) TraceScope traceScope(name)
+#define TRACE_INDEX(name, index) TraceScope traceScope(name, index)
+#else
+#define TRACE(name)
+#define TRACE_INDEX(name, index)
+#endif
+
+#endif // TRACING_P_H